@@ -9,6 +9,11 @@
 #include <fstream>
 #include <sstream>
 #include "HSV.h"
+#include "VertexFormat.h"
+#include "Terrain.h"
+#include "Random.h"
+#include "Particles.h"
+#include "GpuParticles.h"
 namespace nr {
 	namespace util {
 		std::string ReadFile(const std::string& fileName) {
@@ -33,12 +38,6 @@ namespace nr {
 	}
 
 	namespace driver {
-		enum class VERTEXATTRIBUTE : GLuint {
-			POSITION = 0,
-			COLOR = 1,
-			VELOCITY = 2,
-			ANGLE = 3
-		};
 		class Camera {
 		private:
 			float pitch{ 0 };
@@ -152,6 +151,8 @@ namespace nr {
 		class Program {
 		private:
 			std::vector<std::unique_ptr<nr::driver::Shader>> shaders_;
+			// vertex outputs captured by transform feedback, interleaved in this order.
+			std::vector<std::string> feedbackVaryings_;
 			GLuint programID_;
 			inline GLuint GetLocation(const std::string& uniformName) const {
 				return glGetUniformLocation(programID_, uniformName.data());
@@ -160,6 +161,10 @@ namespace nr {
 			void RegisterShader(std::unique_ptr<Shader>&& shader) {
 				shaders_.emplace_back(std::move(shader));
 			}
+			// before Run, since they take effect at link time.
+			void SetFeedbackVaryings(const std::vector<std::string>& varyings) {
+				feedbackVaryings_ = varyings;
+			}
 			bool Run() {
 				// check if shaders are fine first
 				for (const auto& shader : shaders_) {
@@ -172,6 +177,12 @@ namespace nr {
 					glAttachShader(programID_, shader->ID());
 					});
 
+				if (!feedbackVaryings_.empty()) {
+					std::vector<const char*> names;
+					for (const std::string& varying : feedbackVaryings_) names.push_back(varying.data());
+					glTransformFeedbackVaryings(programID_, names.size(), names.data(), GL_INTERLEAVED_ATTRIBS);
+				}
+
 				// link the program
 				glLinkProgram(programID_);
 				int success;
@@ -190,6 +201,7 @@ namespace nr {
 			void Use() {
 				glUseProgram(programID_);
 			}
+			inline GLuint ID() const noexcept { return programID_; }
 			void SetUniformVec3(const std::string& uniformName, const glm::vec3& vec) {
 				GLuint uniformLoc = GetLocation(uniformName);
 				glUniform3f(uniformLoc, vec.x, vec.y, vec.z);
@@ -215,42 +227,9 @@ namespace nr {
 
 namespace nr {
 	namespace util {
-		float RADIUS = 0.05;
-		class Random {
-		private:
-
-			std::random_device rd;
-			std::mt19937 randomGenerator;
-			std::vector <std::pair<nr::driver::VERTEXATTRIBUTE, std::uniform_real_distribution<float>>> distribs;
-		public:
-			Random() :
-				randomGenerator(rd()) {
-
-				const auto PI = 3.14159265;
-				distribs.push_back(std::make_pair< nr::driver::VERTEXATTRIBUTE, std::uniform_real_distribution<float >>(nr::driver::VERTEXATTRIBUTE::POSITION, std::uniform_real_distribution<float >(-RADIUS, RADIUS)));
-				distribs.push_back(std::make_pair< nr::driver::VERTEXATTRIBUTE, std::uniform_real_distribution<float >>(nr::driver::VERTEXATTRIBUTE::COLOR, std::uniform_real_distribution<float >(0, 1)));
-				distribs.push_back(std::make_pair< nr::driver::VERTEXATTRIBUTE, std::uniform_real_distribution<float >>(nr::driver::VERTEXATTRIBUTE::ANGLE, std::uniform_real_distribution<float >(0, 2 * PI)));
-				distribs.push_back(std::make_pair< nr::driver::VERTEXATTRIBUTE, std::uniform_real_distribution<float >>(nr::driver::VERTEXATTRIBUTE::VELOCITY, std::uniform_real_distribution<float >(-0.01, 0.01)));
-			}
-
-			float randomNumber(const nr::driver::VERTEXATTRIBUTE& attrib) {
-				auto found = std::find_if(distribs.begin(), distribs.end(), [&attrib](const auto& p) {
-					return p.first == attrib;
-					});
-				if (found == distribs.end()) throw "register the attrib u fucking idiot;";
-				return found->second(randomGenerator);
-			}
-		};
 		float GetElapsedTime() {
 			return glfwGetTime();
 		}
-		glm::vec3 RandomVector(const float& lowerBound, const float& upperBound) {
-			std::random_device rd;
-			std::mt19937 randomGenerator(rd());
-			std::uniform_real_distribution<float> distrib(lowerBound, upperBound);
-			return { distrib(randomGenerator), distrib(randomGenerator), distrib(randomGenerator) };
-		}
-
 	}
 	namespace callbacks {
 		void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -312,6 +291,30 @@ namespace nr {
 		bool wireframeMode_ = true;
 		unsigned int NUM_POINTS = 4;
 
+		// streams terrain around the camera. off draws the original wave grid in its place.
+		bool terrainEnabled_ = true;
+		std::unique_ptr<nr::driver::Program> terrainProgram_;
+		nr::terrain::Terrain terrain_;
+		// chunks of view distance around the camera, and the most vertex data terrain may keep on the gpu.
+		int terrainRadius_ = 12;
+		GLsizeiptr terrainBudget_ = 32 << 20;
+		bool printStats_ = false;
+		// times bulk random fills against the per-number generator they replaced, at startup.
+		bool benchmarkRandom_ = false;
+
+		// a fountain of particleCapacity_ particles in front of the camera. heavy, so off unless asked for.
+		bool particleDemo_ = false;
+		std::unique_ptr<nr::driver::Program> particleProgram_;
+		// declared before particles_, which runs its kernels on it. only started for the cpu particle demo.
+		std::unique_ptr<nr::util::StealingPool> simulationPool_;
+		nr::particles::ParticleSystem particles_;
+		std::size_t particleCapacity_ = 1 << 20;
+		// simulate particles with transform feedback instead, never touching them on the cpu.
+		bool gpuParticles_ = false;
+		std::unique_ptr<nr::driver::Program> particleUpdateProgram_;
+		nr::particles::GpuParticleSystem gpuParticleSystem_;
+		const unsigned int STATSINTERVAL = 120;
+
 
 
 		namespace init {
@@ -430,15 +433,64 @@ namespace nr {
 				shaderProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_FRAGMENT_SHADER, "fragmentShader", "fragmentShader.frag"));
 				shaderProgram2_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_FRAGMENT_SHADER, "fragmentShader", "fragmentShader.frag"));
 
+				if (terrainEnabled_) {
+					terrainProgram_ = std::make_unique<nr::driver::Program>();
+					terrainProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_VERTEX_SHADER, "terrainVertexShader", "terrain.vert"));
+					terrainProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_FRAGMENT_SHADER, "terrainFragmentShader", "terrain.frag"));
+				}
+
+				if (!particleDemo_) return;
+				// either path draws through particleProgram_, gpu particles also need their update program.
+				particleProgram_ = std::make_unique<nr::driver::Program>();
+				particleProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_VERTEX_SHADER, "particleVertexShader", gpuParticles_ ? "particleDraw.vert" : "particles.vert"));
+				particleProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_FRAGMENT_SHADER, "particleFragmentShader", "particles.frag"));
+				if (gpuParticles_) {
+					particleUpdateProgram_ = std::make_unique<nr::driver::Program>();
+					particleUpdateProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_VERTEX_SHADER, "particleUpdateShader", "particleUpdate.vert"));
+					particleUpdateProgram_->SetFeedbackVaryings(nr::particles::FEEDBACKVARYINGS);
+				}
 			
 			}
+			// a fountain in front of the camera, emitting just fast enough to keep the pool full.
+			bool InitParticles() {
+				if (!particleProgram_->Run()) return false;
+				nr::particles::Emitter fountain;
+				fountain.position_ = glm::vec3(0.0f, 0.0f, -20.0f);
+				fountain.velocity_ = glm::vec3(0.0f, 10.0f, 0.0f);
+				fountain.velocitySpread_ = 3.0f;
+				fountain.minLifetime_ = 2.0f;
+				fountain.maxLifetime_ = 4.0f;
+				fountain.rate_ = particleCapacity_ / fountain.maxLifetime_;
+				fountain.color_ = glm::vec3(0.3f, 0.6f, 1.0f);
+				if (gpuParticles_) {
+					if (!particleUpdateProgram_->Run()) return false;
+					gpuParticleSystem_.Init(particleCapacity_, particleUpdateProgram_->ID());
+					gpuParticleSystem_.SetEmitter(fountain);
+				}
+				else {
+					simulationPool_ = std::make_unique<nr::util::StealingPool>();
+					particles_.Init(particleCapacity_, *simulationPool_);
+					particles_.AddEmitter(fountain);
+				}
+				return true;
+			}
 			bool InitProgram(const unsigned int& windowWidth, const unsigned int& windowHeight, const char* windowName) {
 				if (!glfwInit() || !InitWindow(windowWidth, windowHeight, windowName) || !InitContext()) return false;
 				InitCallbacks();
-				InitArrays();
+				if (!terrainEnabled_) InitArrays();
 				InitShaders();
 				shaderProgram_->Run();
 				shaderProgram2_->Run();
+				if (terrainEnabled_) {
+					if (!terrainProgram_->Run()) return false;
+					terrain_.Init(terrainRadius_, terrainBudget_);
+				}
+				if (particleDemo_ && !InitParticles()) return false;
+				if (benchmarkRandom_) {
+					// only for the comparison, so its threads are gone again once it is done.
+					nr::util::ThreadPool workers;
+					nr::benchmark::CompareRandom(1 << 20, &workers);
+				}
 				return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
 			
 			}
@@ -452,27 +504,97 @@ namespace nr {
 			shaderProgram_->SetUniformFloat("particleCount", NUM_POINTS);
 
 
+			// terrain fogs out at the edge of its view distance, and the far plane sits just past that.
+			if (terrainEnabled_) {
+				const float fogDistance = terrainRadius_ * nr::terrain::CHUNKSIZE;
+				terrainProgram_->Use();
+				terrainProgram_->SetUniformMat4("projectionMatrix", glm::perspective(glm::radians(45.0f), (float)1000 / (float)1000, 0.1f, fogDistance + nr::terrain::CHUNKSIZE));
+				terrainProgram_->SetUniformVec3("lightDirection", glm::normalize(glm::vec3(-0.5f, -1.0f, -0.3f)));
+				terrainProgram_->SetUniformVec3("fogColor", glm::vec3(1.0f));
+				terrainProgram_->SetUniformFloat("fogDistance", fogDistance);
+			}
+
+
+			if (particleDemo_) {
+				particleProgram_->Use();
+				particleProgram_->SetUniformMat4("projectionMatrix", projectionMatrix_);
+				particleProgram_->SetUniformFloat("pointSize", 20.0f);
+				// the gpu path has no per-particle color.
+				particleProgram_->SetUniformVec3("particleColor", glm::vec3(0.3f, 0.6f, 1.0f));
+				glEnable(GL_PROGRAM_POINT_SIZE);
+			}
+
+
 			int frameNumber = 0;
+			float lastFrameTime = nr::util::GetElapsedTime();
 			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			glEnable(GL_DEPTH_TEST);
 			while (!glfwWindowShouldClose(window_)) {
 				// clear the screen
 				glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-				glClear(GL_COLOR_BUFFER_BIT);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 
 
 				glm::mat4 viewMatrix_ = glm::mat4(1.0f);
 				viewMatrix_ = glm::lookAt(camera_->CameraPosition(), camera_->CameraPosition() + camera_->CameraFront(), camera_->CameraUp());
 
+				// stream chunks around the camera. bounded work per frame, the building happens on the terrain's workers.
+				if (terrainEnabled_) {
+					terrain_.Update(camera_->CameraPosition());
+					terrainProgram_->Use();
+					terrainProgram_->SetUniformMat4("viewMatrix", viewMatrix_);
+					terrainProgram_->SetUniformVec3("cameraPosition", camera_->CameraPosition());
+					glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+					terrain_.Draw();
+					glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+				}
+				// a long stall is simulated as one ordinary frame, rather than launching everything at once.
+				const float frameTime = nr::util::GetElapsedTime();
+				const float dt = std::min(frameTime - lastFrameTime, 0.1f);
+				lastFrameTime = frameTime;
+				if (particleDemo_) {
+					if (gpuParticles_) gpuParticleSystem_.Update(dt);
+					else particles_.Update(dt);
+					particleProgram_->Use();
+					particleProgram_->SetUniformMat4("viewMatrix", viewMatrix_);
+					// blended over the scene, tested against its depth but not writing any.
+					glEnable(GL_BLEND);
+					glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+					glDepthMask(GL_FALSE);
+					if (gpuParticles_) gpuParticleSystem_.Draw();
+					else particles_.Draw();
+					glDepthMask(GL_TRUE);
+					glDisable(GL_BLEND);
+				}
+
+				if (printStats_ && frameNumber % STATSINTERVAL == 0) {
+					if (terrainEnabled_) {
+						const nr::terrain::TerrainStats& stats = terrain_.Stats();
+						std::cout << "terrain: " << stats.drawn_ << " chunks drawn, " << stats.triangles_ << " triangles, " << stats.resident_ << " resident in " << stats.residentBytes_ / 1024 << " kb, " << stats.pending_ << " building, " << stats.uploads_ << " uploads, " << stats.evictions_ << " evictions" << std::endl;
+						terrain_.ResetCounters();
+					}
+					if (particleDemo_ && gpuParticles_) {
+						gpuParticleSystem_.PrintStats(std::cout);
+						gpuParticleSystem_.ResetStats();
+					}
+					else if (particleDemo_) {
+						particles_.PrintStats(std::cout);
+						particles_.ResetStats();
+					}
+				}
+
 				shaderProgram_->Use();
 				shaderProgram_->SetUniformMat4("viewMatrix", viewMatrix_);
 				shaderProgram_->SetUniformFloat("frameNumber", frameNumber);
 
 
 			
-				glBindVertexArray(VAO_);
-				//glDrawArrays(GL_TRIANGLES, 0, 4);
-				glDrawElements(GL_LINE_LOOP, NUM_POINTS, GL_UNSIGNED_INT, 0);
+				if (!terrainEnabled_) {
+					glBindVertexArray(VAO_);
+					//glDrawArrays(GL_TRIANGLES, 0, 4);
+					glDrawElements(GL_LINE_LOOP, NUM_POINTS, GL_UNSIGNED_INT, 0);
+				}
 
 	
 
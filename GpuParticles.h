@@ -0,0 +1,163 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include "VertexFormat.h"
+#include "Particles.h"
+
+namespace nr {
+	namespace particles {
+		// particle state as the update shader reads and writes it. an age at or past the lifetime is dead.
+		struct GpuParticle {
+			glm::vec3 position_;
+			glm::vec3 velocity_;
+			float angle_;
+			glm::vec2 life_;
+		};
+		// the update shader's outputs, in GpuParticle order.
+		const std::vector<std::string> FEEDBACKVARYINGS = { "outPosition", "outVelocity", "outAngle", "outLife" };
+
+		// particles that never leave the gpu. each frame a vertex shader reads every particle from one buffer
+		// and transform feedback writes it, advanced, into the other, with rasterization off; then the two swap.
+		// emission happens in the same pass: the slots of a ring window that advances by the frame's emission
+		// count respawn if dead, so no per-particle state crosses the bus. all the cpu sends is a few uniforms.
+		class GpuParticleSystem {
+		private:
+			GLsizei capacity_{ 0 };
+			std::array<GLuint, 2> buffers_{};
+			std::array<GLuint, 2> VAOs_{};
+			// the buffer holding the latest state.
+			unsigned int current_{ 0 };
+			GLuint updateProgram_{ 0 };
+			// the update shader's uniforms, looked up once.
+			GLint dtLocation_, gravityLocation_, dampingLocation_, emitterPositionLocation_, emitterVelocityLocation_;
+			GLint positionSpreadLocation_, velocitySpreadLocation_, lifetimeRangeLocation_, spawnStartLocation_, spawnCountLocation_, capacityLocation_, seedLocation_;
+			Emitter emitter_;
+			glm::vec3 gravity_{ 0.0f, -9.8f, 0.0f };
+			float drag_{ 0.1f };
+			// start of the next frame's spawn window.
+			GLsizei spawnStart_{ 0 };
+			std::uint32_t frame_{ 0 };
+			// GL_TIME_ELAPSED around the update pass, read back a frame late so it never stalls.
+			// a result the gpu has not finished by then is dropped.
+			std::array<GLuint, 2> queries_{};
+			double updateTime_{ 0 };
+			unsigned int timedFrames_{ 0 };
+		public:
+			// program is the linked update program, with FEEDBACKVARYINGS set. needs a current context.
+			void Init(const GLsizei& capacity, const GLuint& program) {
+				capacity_ = capacity;
+				updateProgram_ = program;
+				dtLocation_ = glGetUniformLocation(program, "dt");
+				gravityLocation_ = glGetUniformLocation(program, "gravity");
+				dampingLocation_ = glGetUniformLocation(program, "damping");
+				emitterPositionLocation_ = glGetUniformLocation(program, "emitterPosition");
+				emitterVelocityLocation_ = glGetUniformLocation(program, "emitterVelocity");
+				positionSpreadLocation_ = glGetUniformLocation(program, "positionSpread");
+				velocitySpreadLocation_ = glGetUniformLocation(program, "velocitySpread");
+				lifetimeRangeLocation_ = glGetUniformLocation(program, "lifetimeRange");
+				spawnStartLocation_ = glGetUniformLocation(program, "spawnStart");
+				spawnCountLocation_ = glGetUniformLocation(program, "spawnCount");
+				capacityLocation_ = glGetUniformLocation(program, "capacity");
+				seedLocation_ = glGetUniformLocation(program, "seed");
+
+				// zeroed particles have age 0 and lifetime 0, so everything starts dead.
+				const std::vector<GpuParticle> particles(capacity_, GpuParticle{});
+				glGenBuffers(2, buffers_.data());
+				glGenVertexArrays(2, VAOs_.data());
+				for (unsigned int i = 0; i < 2; ++i) {
+					glBindVertexArray(VAOs_[i]);
+					glBindBuffer(GL_ARRAY_BUFFER, buffers_[i]);
+					glBufferData(GL_ARRAY_BUFFER, capacity_ * sizeof(GpuParticle), particles.data(), GL_DYNAMIC_COPY);
+					glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::POSITION), 3, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (void*)offsetof(GpuParticle, position_));
+					glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::VELOCITY), 3, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (void*)offsetof(GpuParticle, velocity_));
+					glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::ANGLE), 1, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (void*)offsetof(GpuParticle, angle_));
+					glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::LIFE), 2, GL_FLOAT, GL_FALSE, sizeof(GpuParticle), (void*)offsetof(GpuParticle, life_));
+					glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::POSITION));
+					glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::VELOCITY));
+					glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::ANGLE));
+					glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::LIFE));
+				}
+				glBindVertexArray(0);
+				glGenQueries(2, queries_.data());
+			}
+			// only one emitter, the spawn window is a single ring.
+			inline void SetEmitter(const Emitter& emitter) { emitter_ = emitter; }
+			inline void SetForces(const glm::vec3& gravity, const float& drag) {
+				gravity_ = gravity;
+				drag_ = drag;
+			}
+			void Update(const float& dt) {
+				// slots come round again after capacity / rate seconds. one still alive then is left alone and its spawn
+				// dropped, so with lifetimes longer than that fewer particles come out than rate asks for.
+				emitter_.owed_ += emitter_.rate_ * dt;
+				const GLsizei spawnCount = std::min<GLsizei>(static_cast<GLsizei>(emitter_.owed_), capacity_);
+				emitter_.owed_ -= spawnCount;
+
+				// the previous frame's time, if the gpu has finished it.
+				const GLuint previous = queries_[(frame_ + 1) % 2];
+				GLint available = GL_FALSE;
+				if (frame_ > 0) glGetQueryObjectiv(previous, GL_QUERY_RESULT_AVAILABLE, &available);
+				if (available) {
+					GLuint64 elapsed = 0;
+					glGetQueryObjectui64v(previous, GL_QUERY_RESULT, &elapsed);
+					updateTime_ += elapsed / 1e6;
+					++timedFrames_;
+				}
+
+				glUseProgram(updateProgram_);
+				glUniform1f(dtLocation_, dt);
+				glUniform3f(gravityLocation_, gravity_.x, gravity_.y, gravity_.z);
+				glUniform1f(dampingLocation_, std::exp(-drag_ * dt));
+				glUniform3f(emitterPositionLocation_, emitter_.position_.x, emitter_.position_.y, emitter_.position_.z);
+				glUniform3f(emitterVelocityLocation_, emitter_.velocity_.x, emitter_.velocity_.y, emitter_.velocity_.z);
+				glUniform1f(positionSpreadLocation_, emitter_.positionSpread_);
+				glUniform1f(velocitySpreadLocation_, emitter_.velocitySpread_);
+				glUniform2f(lifetimeRangeLocation_, emitter_.minLifetime_, emitter_.maxLifetime_);
+				glUniform1i(spawnStartLocation_, spawnStart_);
+				glUniform1i(spawnCountLocation_, spawnCount);
+				glUniform1i(capacityLocation_, capacity_);
+				glUniform1ui(seedLocation_, frame_);
+
+				glBeginQuery(GL_TIME_ELAPSED, queries_[frame_ % 2]);
+				glEnable(GL_RASTERIZER_DISCARD);
+				glBindVertexArray(VAOs_[current_]);
+				glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers_[1 - current_]);
+				glBeginTransformFeedback(GL_POINTS);
+				glDrawArrays(GL_POINTS, 0, capacity_);
+				glEndTransformFeedback();
+				glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+				glBindVertexArray(0);
+				glDisable(GL_RASTERIZER_DISCARD);
+				glEndQuery(GL_TIME_ELAPSED);
+
+				current_ = 1 - current_;
+				spawnStart_ = (spawnStart_ + spawnCount) % capacity_;
+				++frame_;
+			}
+			// points from the latest state, with the draw program already in use.
+			void Draw() const {
+				glBindVertexArray(VAOs_[current_]);
+				glDrawArrays(GL_POINTS, 0, capacity_);
+				glBindVertexArray(0);
+			}
+			inline GLsizei Capacity() const noexcept { return capacity_; }
+			// the buffer holding the latest state.
+			inline GLuint Buffer() const noexcept { return buffers_[current_]; }
+			void PrintStats(std::ostream& stream) const {
+				stream << "gpu particles: " << capacity_ << " simulated, update " << updateTime_ / std::max(1u, timedFrames_) << " ms on the gpu" << std::endl;
+			}
+			inline void ResetStats() noexcept {
+				updateTime_ = 0;
+				timedFrames_ = 0;
+			}
+		};
+	}
+}
@@ -0,0 +1,330 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstddef>
+#include <cmath>
+#include <iostream>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <malloc.h>
+#include <intrin.h>
+#endif
+#include "VertexFormat.h"
+#include "ThreadPool.h"
+#include "Random.h"
+
+namespace nr {
+	namespace particles {
+		// particles per task. a multiple of LANES, so the kernels never see a partial vector.
+		const std::size_t GRAIN = 16384;
+		const std::size_t LANES = 8;
+
+		struct Emitter {
+			glm::vec3 position_{ 0.0f };
+			glm::vec3 velocity_{ 0.0f, 4.0f, 0.0f };
+			// random offsets from position_ and velocity_, per axis.
+			float positionSpread_{ 0.05f };
+			float velocitySpread_{ 1.0f };
+			// particles per second.
+			float rate_{ 1000.0f };
+			float minLifetime_{ 1.0f };
+			float maxLifetime_{ 2.0f };
+			glm::vec3 color_{ 1.0f };
+			float colorSpread_{ 0.2f };
+			// carried between frames, so low rates still emit.
+			float owed_{ 0.0f };
+		};
+
+		// what reaches the vbo per particle: a position and rgba8 color, faded out over its lifetime.
+		struct ParticleVertex {
+			float x_, y_, z_;
+			std::uint32_t color_;
+		};
+
+		struct ParticleStats {
+			// summed over the frames since the last ResetStats, in milliseconds.
+			double emit_{ 0 };
+			double integrate_{ 0 };
+			double write_{ 0 };
+			unsigned int frames_{ 0 };
+			std::size_t emitted_{ 0 };
+			// as of the last update.
+			std::size_t alive_{ 0 };
+		};
+
+		// float arrays aligned for avx loads. count must be a multiple of LANES.
+		struct AlignedDelete {
+			inline void operator()(float* data) const noexcept {
+#if defined(_MSC_VER)
+				_aligned_free(data);
+#else
+				std::free(data);
+#endif
+			}
+		};
+		using AlignedArray = std::unique_ptr<float[], AlignedDelete>;
+		inline AlignedArray MakeArray(const std::size_t& count, const float& value = 0.0f) {
+#if defined(_MSC_VER)
+			AlignedArray array(static_cast<float*>(_aligned_malloc(count * sizeof(float), 32)));
+#else
+			AlignedArray array(static_cast<float*>(std::aligned_alloc(32, count * sizeof(float))));
+#endif
+			std::fill(array.get(), array.get() + count, value);
+			return array;
+		}
+
+		// a fixed pool of particles kept as structure of arrays and simulated in parallel chunks of GRAIN.
+		// dead particles keep their slot. each frame emits into the slots the previous frame found dead,
+		// integrates everything with avx2, and writes positions and faded colors straight into a mapped vbo.
+		class ParticleSystem {
+		private:
+			std::size_t capacity_{ 0 };
+			AlignedArray positionX_, positionY_, positionZ_;
+			AlignedArray velocityX_, velocityY_, velocityZ_;
+			AlignedArray angle_, spin_;
+			AlignedArray age_, lifetime_;
+			// rgb8 base color, alpha is computed from age when writing.
+			std::vector<std::uint32_t> color_;
+			// dead slots per chunk, rebuilt by the chunk's own integrate task.
+			std::vector<std::vector<std::uint32_t>> dead_;
+			std::vector<std::size_t> alive_;
+			std::vector<Emitter> emitters_;
+			glm::vec3 gravity_{ 0.0f, -9.8f, 0.0f };
+			// fraction of velocity lost per second.
+			float drag_{ 0.1f };
+			nr::util::StealingPool* pool_{ nullptr };
+			nr::util::Random random_;
+			// scratch for emission, filled in bulk.
+			std::vector<float> spawn_;
+			GLuint VAO_{ 0 };
+			GLuint VBO_{ 0 };
+			ParticleStats stats_;
+
+			using Clock = std::chrono::steady_clock;
+			static inline double Milliseconds(const Clock::time_point& from, const Clock::time_point& to) {
+				return std::chrono::duration<double, std::milli>(to - from).count();
+			}
+			static inline unsigned int LowestBit(const unsigned int& mask) {
+#if defined(_MSC_VER)
+				unsigned long bit;
+				_BitScanForward(&bit, mask);
+				return bit;
+#else
+				return __builtin_ctz(mask);
+#endif
+			}
+			static inline std::uint32_t PackColor(const glm::vec3& color) {
+				const glm::vec3 clamped = glm::clamp(color, 0.0f, 1.0f) * 255.0f;
+				return static_cast<std::uint32_t>(clamped.x + 0.5f) | static_cast<std::uint32_t>(clamped.y + 0.5f) << 8 | static_cast<std::uint32_t>(clamped.z + 0.5f) << 16;
+			}
+
+			void Emit(const float& dt) {
+				for (Emitter& emitter : emitters_) {
+					emitter.owed_ += emitter.rate_ * dt;
+					std::size_t count = static_cast<std::size_t>(emitter.owed_);
+					emitter.owed_ -= count;
+					// positions, velocities, lifetime, spin and brightness: nine numbers per particle.
+					spawn_.resize(count * 9);
+					float* values = spawn_.data();
+					random_.Fill(values, count * 3, -emitter.positionSpread_, emitter.positionSpread_);
+					random_.Fill(values + count * 3, count * 3, -emitter.velocitySpread_, emitter.velocitySpread_);
+					random_.Fill(values + count * 6, count, emitter.minLifetime_, emitter.maxLifetime_);
+					random_.Fill(nr::driver::VERTEXATTRIBUTE::ANGLE, values + count * 7, count);
+					random_.Fill(values + count * 8, count, 1.0f - emitter.colorSpread_, 1.0f);
+					std::size_t emitted = 0;
+					for (std::size_t chunk = 0; chunk < dead_.size() && emitted < count; ++chunk) {
+						std::vector<std::uint32_t>& dead = dead_[chunk];
+						for (; !dead.empty() && emitted < count; ++emitted) {
+							const std::uint32_t i = dead.back();
+							dead.pop_back();
+							positionX_[i] = emitter.position_.x + values[emitted * 3];
+							positionY_[i] = emitter.position_.y + values[emitted * 3 + 1];
+							positionZ_[i] = emitter.position_.z + values[emitted * 3 + 2];
+							velocityX_[i] = emitter.velocity_.x + values[(count + emitted) * 3];
+							velocityY_[i] = emitter.velocity_.y + values[(count + emitted) * 3 + 1];
+							velocityZ_[i] = emitter.velocity_.z + values[(count + emitted) * 3 + 2];
+							lifetime_[i] = values[count * 6 + emitted];
+							age_[i] = 0.0f;
+							angle_[i] = 0.0f;
+							spin_[i] = values[count * 7 + emitted];
+							color_[i] = PackColor(emitter.color_ * values[count * 8 + emitted]);
+						}
+					}
+					// a full pool drops the rest rather than carrying them over.
+					stats_.emitted_ += emitted;
+				}
+			}
+			void Integrate(const std::size_t& begin, const std::size_t& end, const float& dt) {
+				std::vector<std::uint32_t>& dead = dead_[begin / GRAIN];
+				dead.clear();
+				std::size_t alive = 0;
+				// exact decay for any dt, rather than 1 - drag * dt.
+				const float damping = std::exp(-drag_ * dt);
+				const glm::vec3 gravity = gravity_ * dt;
+#if defined(__AVX2__)
+				const __m256 dtv = _mm256_set1_ps(dt);
+				const __m256 dampingv = _mm256_set1_ps(damping);
+				const __m256 gx = _mm256_set1_ps(gravity.x), gy = _mm256_set1_ps(gravity.y), gz = _mm256_set1_ps(gravity.z);
+				for (std::size_t i = begin; i < end; i += LANES) {
+					const __m256 age = _mm256_add_ps(_mm256_load_ps(&age_[i]), dtv);
+					_mm256_store_ps(&age_[i], age);
+					const __m256 vx = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(&velocityX_[i]), gx), dampingv);
+					const __m256 vy = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(&velocityY_[i]), gy), dampingv);
+					const __m256 vz = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(&velocityZ_[i]), gz), dampingv);
+					_mm256_store_ps(&velocityX_[i], vx);
+					_mm256_store_ps(&velocityY_[i], vy);
+					_mm256_store_ps(&velocityZ_[i], vz);
+					_mm256_store_ps(&positionX_[i], _mm256_add_ps(_mm256_load_ps(&positionX_[i]), _mm256_mul_ps(vx, dtv)));
+					_mm256_store_ps(&positionY_[i], _mm256_add_ps(_mm256_load_ps(&positionY_[i]), _mm256_mul_ps(vy, dtv)));
+					_mm256_store_ps(&positionZ_[i], _mm256_add_ps(_mm256_load_ps(&positionZ_[i]), _mm256_mul_ps(vz, dtv)));
+					_mm256_store_ps(&angle_[i], _mm256_add_ps(_mm256_load_ps(&angle_[i]), _mm256_mul_ps(_mm256_load_ps(&spin_[i]), dtv)));
+					unsigned int deadMask = _mm256_movemask_ps(_mm256_cmp_ps(age, _mm256_load_ps(&lifetime_[i]), _CMP_GE_OQ));
+					alive += LANES;
+					for (; deadMask; deadMask &= deadMask - 1) {
+						dead.push_back(static_cast<std::uint32_t>(i + LowestBit(deadMask)));
+						--alive;
+					}
+				}
+#else
+				for (std::size_t i = begin; i < end; ++i) {
+					age_[i] += dt;
+					velocityX_[i] = (velocityX_[i] + gravity.x) * damping;
+					velocityY_[i] = (velocityY_[i] + gravity.y) * damping;
+					velocityZ_[i] = (velocityZ_[i] + gravity.z) * damping;
+					positionX_[i] += velocityX_[i] * dt;
+					positionY_[i] += velocityY_[i] * dt;
+					positionZ_[i] += velocityZ_[i] * dt;
+					angle_[i] += spin_[i] * dt;
+					if (age_[i] >= lifetime_[i]) dead.push_back(static_cast<std::uint32_t>(i));
+					else ++alive;
+				}
+#endif
+				alive_[begin / GRAIN] = alive;
+			}
+			// dead particles get alpha 0, which the vertex shader clips away.
+			void Write(const std::size_t& begin, const std::size_t& end, ParticleVertex* out) {
+#if defined(__AVX2__)
+				const __m256 zero = _mm256_setzero_ps();
+				const __m256 one = _mm256_set1_ps(1.0f);
+				const __m256 full = _mm256_set1_ps(255.0f);
+				for (std::size_t i = begin; i < end; i += LANES) {
+					const __m256 age = _mm256_load_ps(&age_[i]);
+					const __m256 lifetime = _mm256_load_ps(&lifetime_[i]);
+					// 1 - age / lifetime, clamped, so dead slots come out at exactly 0.
+					__m256 alpha = _mm256_sub_ps(one, _mm256_div_ps(age, _mm256_max_ps(lifetime, _mm256_set1_ps(1e-6f))));
+					alpha = _mm256_min_ps(_mm256_max_ps(alpha, zero), one);
+					const __m256i alphaBits = _mm256_slli_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(alpha, full)), 24);
+					const __m256i color = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&color_[i])), alphaBits);
+					// 4x8 transpose, from x, y, z and color arrays to eight interleaved vertices.
+					const __m256 x = _mm256_load_ps(&positionX_[i]);
+					const __m256 y = _mm256_load_ps(&positionY_[i]);
+					const __m256 z = _mm256_load_ps(&positionZ_[i]);
+					const __m256 c = _mm256_castsi256_ps(color);
+					const __m256 xy0 = _mm256_unpacklo_ps(x, y);
+					const __m256 xy1 = _mm256_unpackhi_ps(x, y);
+					const __m256 zc0 = _mm256_unpacklo_ps(z, c);
+					const __m256 zc1 = _mm256_unpackhi_ps(z, c);
+					const __m256 v0 = _mm256_shuffle_ps(xy0, zc0, 0x44);
+					const __m256 v1 = _mm256_shuffle_ps(xy0, zc0, 0xee);
+					const __m256 v2 = _mm256_shuffle_ps(xy1, zc1, 0x44);
+					const __m256 v3 = _mm256_shuffle_ps(xy1, zc1, 0xee);
+					float* vertex = reinterpret_cast<float*>(out + i);
+					_mm256_storeu_ps(vertex, _mm256_permute2f128_ps(v0, v1, 0x20));
+					_mm256_storeu_ps(vertex + 8, _mm256_permute2f128_ps(v2, v3, 0x20));
+					_mm256_storeu_ps(vertex + 16, _mm256_permute2f128_ps(v0, v1, 0x31));
+					_mm256_storeu_ps(vertex + 24, _mm256_permute2f128_ps(v2, v3, 0x31));
+				}
+#else
+				for (std::size_t i = begin; i < end; ++i) {
+					const float alpha = std::min(std::max(1.0f - age_[i] / std::max(lifetime_[i], 1e-6f), 0.0f), 1.0f);
+					out[i] = { positionX_[i], positionY_[i], positionZ_[i], color_[i] | static_cast<std::uint32_t>(std::lrint(alpha * 255.0f)) << 24 };
+				}
+#endif
+			}
+		public:
+			// capacity is rounded up to a multiple of LANES. needs a current context.
+			void Init(const std::size_t& capacity, nr::util::StealingPool& pool, const std::uint64_t& seed = nr::util::Random::DEFAULTSEED) {
+				capacity_ = (capacity + LANES - 1) / LANES * LANES;
+				pool_ = &pool;
+				random_.Seed(seed);
+				for (AlignedArray* array : { &positionX_, &positionY_, &positionZ_, &velocityX_, &velocityY_, &velocityZ_, &angle_, &spin_, &lifetime_ }) *array = MakeArray(capacity_);
+				// everything starts dead.
+				age_ = MakeArray(capacity_, 1.0f);
+				color_.assign(capacity_, 0);
+				const std::size_t chunks = (capacity_ + GRAIN - 1) / GRAIN;
+				dead_.assign(chunks, {});
+				alive_.assign(chunks, 0);
+				for (std::size_t i = capacity_; i > 0; --i) dead_[(i - 1) / GRAIN].push_back(static_cast<std::uint32_t>(i - 1));
+
+				glGenVertexArrays(1, &VAO_);
+				glBindVertexArray(VAO_);
+				glGenBuffers(1, &VBO_);
+				glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+				glBufferData(GL_ARRAY_BUFFER, capacity_ * sizeof(ParticleVertex), NULL, GL_STREAM_DRAW);
+				glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::POSITION), 3, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), (void*)0);
+				glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::COLOR), 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ParticleVertex), (void*)offsetof(ParticleVertex, color_));
+				glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::POSITION));
+				glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::COLOR));
+				glBindVertexArray(0);
+			}
+			inline std::size_t AddEmitter(const Emitter& emitter) {
+				emitters_.push_back(emitter);
+				return emitters_.size() - 1;
+			}
+			inline Emitter& GetEmitter(const std::size_t& index) { return emitters_[index]; }
+			inline void SetForces(const glm::vec3& gravity, const float& drag) {
+				gravity_ = gravity;
+				drag_ = drag;
+			}
+			// one simulation step, leaving the vbo ready to draw.
+			void Update(const float& dt) {
+				const Clock::time_point start = Clock::now();
+				Emit(dt);
+				const Clock::time_point emitted = Clock::now();
+				pool_->ParallelFor(capacity_, GRAIN, [this, dt](const std::size_t& begin, const std::size_t& end) { Integrate(begin, end, dt); });
+				const Clock::time_point integrated = Clock::now();
+				// the old contents are orphaned, so mapping never waits on last frame's draw.
+				glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+				ParticleVertex* vertices = static_cast<ParticleVertex*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, capacity_ * sizeof(ParticleVertex), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+				if (vertices) {
+					pool_->ParallelFor(capacity_, GRAIN, [this, vertices](const std::size_t& begin, const std::size_t& end) { Write(begin, end, vertices); });
+					glUnmapBuffer(GL_ARRAY_BUFFER);
+				}
+				else std::cout << "particles: could not map the vertex buffer" << std::endl;
+				const Clock::time_point written = Clock::now();
+
+				stats_.emit_ += Milliseconds(start, emitted);
+				stats_.integrate_ += Milliseconds(emitted, integrated);
+				stats_.write_ += Milliseconds(integrated, written);
+				++stats_.frames_;
+				stats_.alive_ = 0;
+				for (const std::size_t& alive : alive_) stats_.alive_ += alive;
+			}
+			// points, with the particle program already in use.
+			void Draw() const {
+				glBindVertexArray(VAO_);
+				glDrawArrays(GL_POINTS, 0, capacity_);
+				glBindVertexArray(0);
+			}
+			inline std::size_t Capacity() const noexcept { return capacity_; }
+			inline const ParticleStats& Stats() const noexcept { return stats_; }
+			inline void ResetStats() noexcept {
+				const std::size_t alive = stats_.alive_;
+				stats_ = {};
+				stats_.alive_ = alive;
+			}
+			void PrintStats(std::ostream& stream) const {
+				const double frames = std::max(1u, stats_.frames_);
+				stream << "particles: " << stats_.alive_ << " alive of " << capacity_ << ", " << stats_.emitted_ / frames << " emitted per frame. emit " << stats_.emit_ / frames << " ms, integrate " << stats_.integrate_ / frames << " ms, write " << stats_.write_ / frames << " ms on " << pool_->Size() << " threads, " << pool_->Steals() << " steals" << std::endl;
+			}
+		};
+	}
+}
@@ -0,0 +1,244 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <array>
+#include <vector>
+#include <string>
+#include <random>
+#include <future>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "VertexFormat.h"
+#include "ThreadPool.h"
+
+namespace nr {
+	namespace util {
+		float RADIUS = 0.05;
+
+		// xoshiro128+ run as LANECOUNT independent generators side by side, eight floats per step.
+		// with avx2 a step is a handful of vector instructions, otherwise the same lanes are stepped in a
+		// plain loop the compiler can vectorize. both produce the same numbers for the same seed.
+		// the same (seed, stream) always gives the same sequence, and distinct streams are seeded apart,
+		// so each thread filling its own slice with its own stream is reproducible whatever the thread count.
+		class Random {
+		public:
+			static constexpr unsigned int LANECOUNT = 8;
+			static constexpr std::uint64_t DEFAULTSEED = 0x6e722d72616e64ull;
+		private:
+			// state word k of every lane, so a state word is one vector register.
+			alignas(32) std::array<std::array<std::uint32_t, LANECOUNT>, 4> state_;
+			// [lower, upper) per attribute, indexed by the attribute's location.
+			std::array<std::pair<float, float>, nr::driver::ATTRIBUTECOUNT> ranges_;
+			// what is left of the last step, for Next().
+			alignas(32) std::array<float, LANECOUNT> spare_;
+			unsigned int spareCount_{ 0 };
+
+			static inline std::uint64_t SplitMix(std::uint64_t& x) {
+				std::uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+				return z ^ (z >> 31);
+			}
+			// LANECOUNT floats in [lower, upper).
+			inline void Step(float* out, const float& lower, const float& upper) {
+				const float scale = (upper - lower) / 16777216.0f;
+#if defined(__AVX2__)
+				__m256i s0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state_[0].data()));
+				__m256i s1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state_[1].data()));
+				__m256i s2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state_[2].data()));
+				__m256i s3 = _mm256_load_si256(reinterpret_cast<const __m256i*>(state_[3].data()));
+				// top 24 bits, exactly representable, scaled into the range.
+				const __m256i bits = _mm256_srli_epi32(_mm256_add_epi32(s0, s3), 8);
+				const __m256 value = _mm256_add_ps(_mm256_set1_ps(lower), _mm256_mul_ps(_mm256_cvtepi32_ps(bits), _mm256_set1_ps(scale)));
+				_mm256_storeu_ps(out, value);
+				const __m256i t = _mm256_slli_epi32(s1, 9);
+				s2 = _mm256_xor_si256(s2, s0);
+				s3 = _mm256_xor_si256(s3, s1);
+				s1 = _mm256_xor_si256(s1, s2);
+				s0 = _mm256_xor_si256(s0, s3);
+				s2 = _mm256_xor_si256(s2, t);
+				s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11), _mm256_srli_epi32(s3, 21));
+				_mm256_store_si256(reinterpret_cast<__m256i*>(state_[0].data()), s0);
+				_mm256_store_si256(reinterpret_cast<__m256i*>(state_[1].data()), s1);
+				_mm256_store_si256(reinterpret_cast<__m256i*>(state_[2].data()), s2);
+				_mm256_store_si256(reinterpret_cast<__m256i*>(state_[3].data()), s3);
+#else
+				for (unsigned int lane = 0; lane < LANECOUNT; ++lane) {
+					std::uint32_t& s0 = state_[0][lane];
+					std::uint32_t& s1 = state_[1][lane];
+					std::uint32_t& s2 = state_[2][lane];
+					std::uint32_t& s3 = state_[3][lane];
+					out[lane] = lower + static_cast<float>((s0 + s3) >> 8) * scale;
+					const std::uint32_t t = s1 << 9;
+					s2 ^= s0;
+					s3 ^= s1;
+					s1 ^= s2;
+					s0 ^= s3;
+					s2 ^= t;
+					s3 = (s3 << 11) | (s3 >> 21);
+				}
+#endif
+			}
+		public:
+			explicit Random(const std::uint64_t& seed = DEFAULTSEED, const std::uint64_t& stream = 0) {
+				const float PI = 3.14159265f;
+				SetRange(nr::driver::VERTEXATTRIBUTE::POSITION, -RADIUS, RADIUS);
+				SetRange(nr::driver::VERTEXATTRIBUTE::COLOR, 0.0f, 1.0f);
+				SetRange(nr::driver::VERTEXATTRIBUTE::VELOCITY, -0.01f, 0.01f);
+				SetRange(nr::driver::VERTEXATTRIBUTE::ANGLE, 0.0f, 2 * PI);
+				SetRange(nr::driver::VERTEXATTRIBUTE::NORMAL, -1.0f, 1.0f);
+				Seed(seed, stream);
+			}
+			void Seed(const std::uint64_t& seed, const std::uint64_t& stream = 0) {
+				std::uint64_t x = seed ^ (stream * 0xd1342543de82ef95ull);
+				// splitmix never hands out an all zero lane, which xoshiro could not leave.
+				for (unsigned int lane = 0; lane < LANECOUNT; ++lane) {
+					const std::uint64_t a = SplitMix(x);
+					const std::uint64_t b = SplitMix(x);
+					state_[0][lane] = static_cast<std::uint32_t>(a);
+					state_[1][lane] = static_cast<std::uint32_t>(a >> 32);
+					state_[2][lane] = static_cast<std::uint32_t>(b);
+					state_[3][lane] = static_cast<std::uint32_t>(b >> 32);
+				}
+				spareCount_ = 0;
+			}
+			inline void SetRange(const nr::driver::VERTEXATTRIBUTE& attrib, const float& lower, const float& upper) {
+				ranges_[static_cast<GLuint>(attrib)] = { lower, upper };
+			}
+			// count floats in the attribute's range.
+			inline void Fill(const nr::driver::VERTEXATTRIBUTE& attrib, float* out, const std::size_t& count) {
+				const std::pair<float, float>& range = ranges_[static_cast<GLuint>(attrib)];
+				Fill(out, count, range.first, range.second);
+			}
+			void Fill(float* out, const std::size_t& count, const float& lower, const float& upper) {
+				std::size_t i = 0;
+				for (; i + LANECOUNT <= count; i += LANECOUNT) Step(out + i, lower, upper);
+				if (i == count) return;
+				alignas(32) std::array<float, LANECOUNT> tail;
+				Step(tail.data(), lower, upper);
+				std::memcpy(out + i, tail.data(), (count - i) * sizeof(float));
+			}
+			// one number at a time, for the odd value. prefer Fill for anything in bulk.
+			inline float Next(const nr::driver::VERTEXATTRIBUTE& attrib) {
+				const std::pair<float, float>& range = ranges_[static_cast<GLuint>(attrib)];
+				if (!spareCount_) {
+					Step(spare_.data(), 0.0f, 1.0f);
+					spareCount_ = LANECOUNT;
+				}
+				return range.first + spare_[--spareCount_] * (range.second - range.first);
+			}
+			inline glm::vec3 Vector(const float& lowerBound, const float& upperBound) {
+				alignas(32) std::array<float, LANECOUNT> values;
+				Step(values.data(), lowerBound, upperBound);
+				return { values[0], values[1], values[2] };
+			}
+		};
+
+		// per thread, so callers need no locking. seeded from the thread id, so not reproducible: use a Random for that.
+		glm::vec3 RandomVector(const float& lowerBound, const float& upperBound) {
+			thread_local Random random(Random::DEFAULTSEED, std::hash<std::thread::id>()(std::this_thread::get_id()));
+			return random.Vector(lowerBound, upperBound);
+		}
+
+		// count floats of attrib split over the pool. the output depends only on seed, never on the thread count,
+		// because slice i always draws from stream i.
+		void ParallelFill(nr::util::ThreadPool& pool, const nr::driver::VERTEXATTRIBUTE& attrib, float* out, const std::size_t& count, const std::uint64_t& seed = Random::DEFAULTSEED) {
+			const std::size_t SLICESIZE = 1 << 16;
+			std::vector<std::future<void>> slices;
+			for (std::size_t begin = 0; begin < count; begin += SLICESIZE) {
+				const std::size_t size = std::min(SLICESIZE, count - begin);
+				slices.push_back(pool.Submit([attrib, out, begin, size, seed]() {
+					Random(seed, begin / SLICESIZE).Fill(attrib, out + begin, size);
+				}));
+			}
+			for (auto& slice : slices) slice.get();
+		}
+	}
+
+	namespace benchmark {
+		// the generator Random replaced, kept as a baseline: a linear search for the attribute's
+		// distribution and an mt19937 draw per number, and a fresh random_device and mt19937 per vector.
+		class LegacyRandom {
+		private:
+			std::random_device rd;
+			std::mt19937 randomGenerator;
+			std::vector<std::pair<nr::driver::VERTEXATTRIBUTE, std::uniform_real_distribution<float>>> distribs;
+		public:
+			LegacyRandom() :
+				randomGenerator(rd()) {
+				const auto PI = 3.14159265;
+				distribs.push_back({ nr::driver::VERTEXATTRIBUTE::POSITION, std::uniform_real_distribution<float>(-nr::util::RADIUS, nr::util::RADIUS) });
+				distribs.push_back({ nr::driver::VERTEXATTRIBUTE::COLOR, std::uniform_real_distribution<float>(0, 1) });
+				distribs.push_back({ nr::driver::VERTEXATTRIBUTE::ANGLE, std::uniform_real_distribution<float>(0, 2 * PI) });
+				distribs.push_back({ nr::driver::VERTEXATTRIBUTE::VELOCITY, std::uniform_real_distribution<float>(-0.01, 0.01) });
+			}
+			float randomNumber(const nr::driver::VERTEXATTRIBUTE& attrib) {
+				auto found = std::find_if(distribs.begin(), distribs.end(), [&attrib](const auto& p) {
+					return p.first == attrib;
+					});
+				if (found == distribs.end()) throw "attribute has no distribution";
+				return found->second(randomGenerator);
+			}
+			static glm::vec3 RandomVector(const float& lowerBound, const float& upperBound) {
+				std::random_device rd;
+				std::mt19937 randomGenerator(rd());
+				std::uniform_real_distribution<float> distrib(lowerBound, upperBound);
+				return { distrib(randomGenerator), distrib(randomGenerator), distrib(randomGenerator) };
+			}
+		};
+
+		// seeds count particles' worth of position, velocity and color (three floats each) both ways, and prints the times.
+		void CompareRandom(const std::size_t& count, nr::util::ThreadPool* pool = nullptr) {
+			using Clock = std::chrono::steady_clock;
+			auto milliseconds = [](const Clock::time_point& from) { return std::chrono::duration<double, std::milli>(Clock::now() - from).count(); };
+			const std::array<nr::driver::VERTEXATTRIBUTE, 3> attribs = { nr::driver::VERTEXATTRIBUTE::POSITION, nr::driver::VERTEXATTRIBUTE::VELOCITY, nr::driver::VERTEXATTRIBUTE::COLOR };
+			std::vector<float> values(count * 3);
+			// read into a volatile at the end, so the compiler cannot drop work whose result is unused.
+			float sum = 0.0f;
+
+			Clock::time_point start = Clock::now();
+			LegacyRandom legacy;
+			for (const auto& attrib : attribs) {
+				for (float& value : values) value = legacy.randomNumber(attrib);
+				sum += values[count / 2];
+			}
+			const double legacyTime = milliseconds(start);
+
+			// a hundredth of the vectors, random_device per call is slow enough to need it.
+			start = Clock::now();
+			for (std::size_t i = 0; i < count / 100; ++i) sum += LegacyRandom::RandomVector(-1.0f, 1.0f).x;
+			const double legacyVectorTime = milliseconds(start) * 100;
+
+			start = Clock::now();
+			nr::util::Random random;
+			for (const auto& attrib : attribs) {
+				random.Fill(attrib, values.data(), values.size());
+				sum += values[count / 2];
+			}
+			const double bulkTime = milliseconds(start);
+
+			start = Clock::now();
+			for (std::size_t i = 0; i < count; ++i) sum += nr::util::RandomVector(-1.0f, 1.0f).x;
+			const double vectorTime = milliseconds(start);
+
+			double parallelTime = 0;
+			if (pool) {
+				start = Clock::now();
+				for (const auto& attrib : attribs) nr::util::ParallelFill(*pool, attrib, values.data(), values.size());
+				parallelTime = milliseconds(start);
+			}
+
+			std::cout << "random, " << count << " particles: per number " << legacyTime << " ms, bulk " << bulkTime << " ms (" << legacyTime / bulkTime << "x)";
+			if (pool) std::cout << ", parallel bulk on " << pool->Size() << " threads " << parallelTime << " ms";
+			std::cout << ". vectors: old " << legacyVectorTime << " ms (extrapolated), new " << vectorTime << " ms" << std::endl;
+			// keeps the timed loops from being optimised away.
+			volatile float sink = sum;
+			(void)sink;
+		}
+	}
+}
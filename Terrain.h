@@ -0,0 +1,389 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <future>
+#include <chrono>
+#include <memory>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include "VertexFormat.h"
+#include "ThreadPool.h"
+
+namespace nr {
+	namespace terrain {
+		// world units per chunk side.
+		const float CHUNKSIZE = 64.0f;
+		// quads per chunk side at lod 0. every further lod halves it.
+		const unsigned int CHUNKRESOLUTION = 32;
+		const unsigned int LODCOUNT = 4;
+
+		struct TerrainVertex {
+			glm::vec3 position_;
+			glm::vec3 normal_;
+		};
+
+		// fractal value noise. the same inputs give the same heights on every thread and every run,
+		// which is what lets neighbouring chunks built separately meet exactly.
+		class Heightfield {
+		private:
+			std::uint32_t seed_;
+			float amplitude_{ 120.0f };
+			float wavelength_{ 600.0f };
+			unsigned int octaves_{ 6 };
+			// the octaves sum to under twice the amplitude, so this keeps the terrain below the camera's start height.
+			float base_{ -240.0f };
+
+			inline float Lattice(const int& x, const int& z) const {
+				std::uint32_t hash = seed_ ^ (static_cast<std::uint32_t>(x) * 0x8da6b343u) ^ (static_cast<std::uint32_t>(z) * 0xd8163841u);
+				hash = (hash ^ (hash >> 13)) * 0x5bd1e995u;
+				hash ^= hash >> 15;
+				return (hash & 0xffffff) / float(0x1000000);
+			}
+			float Noise(const float& x, const float& z) const {
+				const float cellX = std::floor(x);
+				const float cellZ = std::floor(z);
+				const int ix = static_cast<int>(cellX);
+				const int iz = static_cast<int>(cellZ);
+				// smoothstep weights, so the surface has no creases on the lattice lines.
+				float u = x - cellX;
+				float v = z - cellZ;
+				u = u * u * (3.0f - 2.0f * u);
+				v = v * v * (3.0f - 2.0f * v);
+				const float bottom = Lattice(ix, iz) + (Lattice(ix + 1, iz) - Lattice(ix, iz)) * u;
+				const float top = Lattice(ix, iz + 1) + (Lattice(ix + 1, iz + 1) - Lattice(ix, iz + 1)) * u;
+				return bottom + (top - bottom) * v;
+			}
+		public:
+			explicit Heightfield(const std::uint32_t& seed = 1)
+				:seed_(seed) {
+			}
+			float Height(const float& x, const float& z) const {
+				float height = 0.0f;
+				float amplitude = amplitude_;
+				float frequency = 1.0f / wavelength_;
+				for (unsigned int i = 0; i < octaves_; ++i) {
+					height += Noise(x * frequency, z * frequency) * amplitude;
+					amplitude *= 0.5f;
+					frequency *= 2.0f;
+				}
+				return base_ + height;
+			}
+			// central differences at spacing, fixed per heightfield so every lod shades alike.
+			glm::vec3 Normal(const float& x, const float& z, const float& spacing) const {
+				const float dx = Height(x + spacing, z) - Height(x - spacing, z);
+				const float dz = Height(x, z + spacing) - Height(x, z - spacing);
+				return glm::normalize(glm::vec3(-dx, 2.0f * spacing, -dz));
+			}
+		};
+
+		struct ChunkKey {
+			int x_;
+			int z_;
+			inline bool operator==(const ChunkKey& other) const noexcept { return x_ == other.x_ && z_ == other.z_; }
+		};
+		struct ChunkKeyHash {
+			inline std::size_t operator()(const ChunkKey& key) const noexcept {
+				return std::hash<std::uint64_t>()((static_cast<std::uint64_t>(static_cast<std::uint32_t>(key.x_)) << 32) | static_cast<std::uint32_t>(key.z_));
+			}
+		};
+
+		inline unsigned int Resolution(const unsigned int& lod) { return CHUNKRESOLUTION >> lod; }
+
+		// (resolution + 1)^2 vertices, row major in z. safe to call from any thread.
+		std::vector<TerrainVertex> BuildChunk(const Heightfield& heightfield, const ChunkKey& key, const unsigned int& lod) {
+			const unsigned int resolution = Resolution(lod);
+			// a power of two, so shared edge vertices land on exactly the same coordinates at every lod.
+			const float spacing = CHUNKSIZE / resolution;
+			const float normalSpacing = CHUNKSIZE / CHUNKRESOLUTION;
+			const float originX = key.x_ * CHUNKSIZE;
+			const float originZ = key.z_ * CHUNKSIZE;
+			std::vector<TerrainVertex> vertices;
+			vertices.reserve((resolution + 1) * (resolution + 1));
+			for (unsigned int j = 0; j <= resolution; ++j) {
+				for (unsigned int i = 0; i <= resolution; ++i) {
+					const float x = originX + i * spacing;
+					const float z = originZ + j * spacing;
+					vertices.push_back({ glm::vec3(x, heightfield.Height(x, z), z), heightfield.Normal(x, z, normalSpacing) });
+				}
+			}
+			return vertices;
+		}
+
+		enum EDGE {
+			WEST,
+			EAST,
+			SOUTH,
+			NORTH
+		};
+		// triangles over a chunk's vertex grid. an edge bordering a coarser chunk has its vertices snapped down
+		// to every step-th one, turning that row of quads into fans that end on the coarser chunk's vertices,
+		// so the two meshes share the edge exactly: no cracks and no t-junctions. snapped triangles collapse and are dropped.
+		std::vector<std::uint16_t> BuildIndices(const unsigned int& lod, const std::array<unsigned int, 4>& steps) {
+			const unsigned int resolution = Resolution(lod);
+			auto vertex = [&](unsigned int i, unsigned int j) {
+				if (i == 0) j = j / steps[WEST] * steps[WEST];
+				else if (i == resolution) j = j / steps[EAST] * steps[EAST];
+				if (j == 0) i = i / steps[SOUTH] * steps[SOUTH];
+				else if (j == resolution) i = i / steps[NORTH] * steps[NORTH];
+				return static_cast<std::uint16_t>(j * (resolution + 1) + i);
+			};
+			std::vector<std::uint16_t> indices;
+			indices.reserve(resolution * resolution * 6);
+			auto triangle = [&indices](const std::uint16_t& a, const std::uint16_t& b, const std::uint16_t& c) {
+				if (a == b || b == c || a == c) return;
+				indices.insert(indices.end(), { a, b, c });
+			};
+			for (unsigned int j = 0; j < resolution; ++j) {
+				for (unsigned int i = 0; i < resolution; ++i) {
+					// counter clockwise seen from above.
+					triangle(vertex(i, j), vertex(i, j + 1), vertex(i + 1, j + 1));
+					triangle(vertex(i, j), vertex(i + 1, j + 1), vertex(i + 1, j));
+				}
+			}
+			return indices;
+		}
+
+		struct TerrainStats {
+			unsigned int resident_{ 0 };
+			// uploaded vertex data plus what chunks still being built will upload.
+			GLsizeiptr residentBytes_{ 0 };
+			unsigned int pending_{ 0 };
+			unsigned int drawn_{ 0 };
+			unsigned int triangles_{ 0 };
+			unsigned int uploads_{ 0 };
+			unsigned int evictions_{ 0 };
+		};
+
+		// chunks around the camera, built on worker threads and streamed in and out as it moves.
+		// the lod of each chunk follows its distance, neighbours never differ by more than one lod,
+		// and resident vertex data stays under a byte budget by dropping the farthest chunks first.
+		class Terrain {
+		private:
+			struct Chunk {
+				GLuint vertexBuffer_{ 0 };
+				// what is uploaded, -1 before the first upload.
+				int lod_{ -1 };
+				GLsizeiptr bytes_{ 0 };
+				// held against the budget from submission, so jobs in flight cannot overshoot it.
+				GLsizeiptr reserved_{ 0 };
+				std::future<std::vector<TerrainVertex>> pending_;
+				int pendingLod_{ -1 };
+				// last Update's distance to the camera, for ordering work and eviction.
+				float distance_{ 0.0f };
+			};
+			struct IndexBuffer {
+				GLuint bufferID_{ 0 };
+				GLsizei count_{ 0 };
+			};
+			Heightfield heightfield_;
+			std::unordered_map<ChunkKey, Chunk, ChunkKeyHash> chunks_;
+			// one per (lod, edge steps) combination actually seen, shared by every chunk.
+			std::unordered_map<std::uint32_t, IndexBuffer> indexBuffers_;
+			GLuint VAO_{ 0 };
+			// chunks of view distance.
+			int viewRadius_{ 12 };
+			// lod 0 out to this distance, every doubling of it one lod coarser.
+			float lodDistance_{ 2.0f * CHUNKSIZE };
+			GLsizeiptr budget_{ 32 << 20 };
+			// caps on per-frame work, so streaming never causes a spike.
+			unsigned int uploadsPerFrame_{ 16 };
+			// counts draining_ too, their jobs hold workers as much as any other.
+			unsigned int jobsInFlight_{ 0 };
+			// jobs for evicted chunks, still running. nothing reads what they build, they are only waited out.
+			std::vector<std::future<std::vector<TerrainVertex>>> draining_;
+			TerrainStats stats_;
+			// declared last so its workers are joined before anything they read is destroyed.
+			std::unique_ptr<nr::util::ThreadPool> workers_;
+
+			unsigned int WantedLod(const float& distance) const {
+				if (distance < lodDistance_) return 0;
+				return std::min<unsigned int>(LODCOUNT - 1, static_cast<unsigned int>(std::log2(distance / lodDistance_)) + 1);
+			}
+			const IndexBuffer& Indices(const unsigned int& lod, const std::array<unsigned int, 4>& steps) {
+				std::uint32_t key = lod;
+				for (unsigned int edge = 0; edge < 4; ++edge) key |= static_cast<std::uint32_t>(steps[edge]) << (4 + edge * 8);
+				IndexBuffer& buffer = indexBuffers_[key];
+				if (buffer.bufferID_) return buffer;
+				const std::vector<std::uint16_t> indices = BuildIndices(lod, steps);
+				glGenBuffers(1, &buffer.bufferID_);
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.bufferID_);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(std::uint16_t), indices.data(), GL_STATIC_DRAW);
+				buffer.count_ = indices.size();
+				return buffer;
+			}
+			void Evict(const ChunkKey& key) {
+				Chunk& chunk = chunks_[key];
+				glDeleteBuffers(1, &chunk.vertexBuffer_);
+				stats_.residentBytes_ -= chunk.bytes_ + chunk.reserved_;
+				++stats_.evictions_;
+				if (chunk.pending_.valid()) draining_.push_back(std::move(chunk.pending_));
+				chunks_.erase(key);
+			}
+		public:
+			// needs a current context and a bound program. budgetBytes bounds resident vertex data.
+			void Init(const int& viewRadius, const GLsizeiptr& budgetBytes, const unsigned int& workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1) {
+				viewRadius_ = viewRadius;
+				budget_ = budgetBytes;
+				workers_ = std::make_unique<nr::util::ThreadPool>(workerCount);
+				glGenVertexArrays(1, &VAO_);
+				glBindVertexArray(VAO_);
+				glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::POSITION));
+				glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::NORMAL));
+				glBindVertexArray(0);
+			}
+			// streams around position. cheap when nothing changes.
+			void Update(const glm::vec3& position) {
+				const ChunkKey center{ static_cast<int>(std::floor(position.x / CHUNKSIZE)), static_cast<int>(std::floor(position.z / CHUNKSIZE)) };
+				auto distanceTo = [&position](const ChunkKey& key) {
+					const glm::vec2 chunkCenter((key.x_ + 0.5f) * CHUNKSIZE, (key.z_ + 0.5f) * CHUNKSIZE);
+					return glm::length(chunkCenter - glm::vec2(position.x, position.z));
+				};
+
+				// wanted lods on a square around the camera, relaxed until neighbours are at most one apart.
+				const int side = 2 * viewRadius_ + 1;
+				std::vector<int> wanted(side * side, -1);
+				auto at = [&](const int& x, const int& z) -> int& { return wanted[(z - center.z_ + viewRadius_) * side + (x - center.x_ + viewRadius_)]; };
+				for (int z = center.z_ - viewRadius_; z <= center.z_ + viewRadius_; ++z) {
+					for (int x = center.x_ - viewRadius_; x <= center.x_ + viewRadius_; ++x) {
+						const float distance = distanceTo({ x, z });
+						if (distance <= viewRadius_ * CHUNKSIZE) at(x, z) = WantedLod(distance);
+					}
+				}
+				for (bool changed = true; changed;) {
+					changed = false;
+					for (int z = center.z_ - viewRadius_; z <= center.z_ + viewRadius_; ++z) {
+						for (int x = center.x_ - viewRadius_; x <= center.x_ + viewRadius_; ++x) {
+							int& lod = at(x, z);
+							if (lod < 0) continue;
+							const std::array<ChunkKey, 4> neighbours = { ChunkKey{ x - 1, z }, ChunkKey{ x + 1, z }, ChunkKey{ x, z - 1 }, ChunkKey{ x, z + 1 } };
+							for (const ChunkKey& neighbour : neighbours) {
+								if (std::abs(neighbour.x_ - center.x_) > viewRadius_ || std::abs(neighbour.z_ - center.z_) > viewRadius_) continue;
+								const int neighbourLod = at(neighbour.x_, neighbour.z_);
+								if (neighbourLod >= 0 && lod > neighbourLod + 1) {
+									lod = neighbourLod + 1;
+									changed = true;
+								}
+							}
+						}
+					}
+				}
+
+				// evicted chunks' jobs stop counting once they are done.
+				draining_.erase(std::remove_if(draining_.begin(), draining_.end(), [this](const std::future<std::vector<TerrainVertex>>& job) {
+					if (job.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+					--jobsInFlight_;
+					return true;
+				}), draining_.end());
+
+				// finished jobs in, nearest first, a bounded number per frame.
+				std::vector<ChunkKey> order;
+				for (auto& entry : chunks_) {
+					entry.second.distance_ = distanceTo(entry.first);
+					order.push_back(entry.first);
+				}
+				std::sort(order.begin(), order.end(), [this](const ChunkKey& a, const ChunkKey& b) { return chunks_[a].distance_ < chunks_[b].distance_; });
+				unsigned int uploads = 0;
+				for (const ChunkKey& key : order) {
+					Chunk& chunk = chunks_[key];
+					if (uploads == uploadsPerFrame_) break;
+					if (!chunk.pending_.valid() || chunk.pending_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) continue;
+					const std::vector<TerrainVertex> vertices = chunk.pending_.get();
+					--jobsInFlight_;
+					if (!chunk.vertexBuffer_) glGenBuffers(1, &chunk.vertexBuffer_);
+					glBindBuffer(GL_ARRAY_BUFFER, chunk.vertexBuffer_);
+					glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(TerrainVertex), vertices.data(), GL_STATIC_DRAW);
+					stats_.residentBytes_ -= chunk.bytes_;
+					chunk.bytes_ = chunk.reserved_;
+					chunk.reserved_ = 0;
+					chunk.lod_ = chunk.pendingLod_;
+					++uploads;
+					++stats_.uploads_;
+				}
+
+				// out of range, with a chunk of slack so walking along a border does not thrash.
+				for (const ChunkKey& key : order) {
+					if (std::max(std::abs(key.x_ - center.x_), std::abs(key.z_ - center.z_)) > viewRadius_ + 1) Evict(key);
+				}
+
+				// new work, nearest first. a chunk keeps drawing at its old lod until the new one arrives.
+				std::vector<std::pair<float, ChunkKey>> requests;
+				for (int z = center.z_ - viewRadius_; z <= center.z_ + viewRadius_; ++z) {
+					for (int x = center.x_ - viewRadius_; x <= center.x_ + viewRadius_; ++x) {
+						const int lod = at(x, z);
+						if (lod < 0) continue;
+						auto found = chunks_.find({ x, z });
+						if (found != chunks_.end() && (found->second.lod_ == lod || found->second.pending_.valid())) continue;
+						requests.push_back({ distanceTo({ x, z }), { x, z } });
+					}
+				}
+				std::sort(requests.begin(), requests.end(), [](const std::pair<float, ChunkKey>& a, const std::pair<float, ChunkKey>& b) { return a.first < b.first; });
+				const unsigned int maxJobs = 2 * workers_->Size();
+				for (const auto& request : requests) {
+					if (jobsInFlight_ >= maxJobs) break;
+					const int lod = at(request.second.x_, request.second.z_);
+					const GLsizeiptr bytes = (Resolution(lod) + 1) * (Resolution(lod) + 1) * sizeof(TerrainVertex);
+					// make room by dropping chunks farther than this one. if there are none, everything
+					// resident matters more, and the remaining requests are farther still.
+					while (stats_.residentBytes_ + bytes > budget_) {
+						auto farthest = std::max_element(chunks_.begin(), chunks_.end(), [](const auto& a, const auto& b) { return a.second.distance_ < b.second.distance_; });
+						if (farthest == chunks_.end() || farthest->second.distance_ <= request.first) break;
+						Evict(farthest->first);
+					}
+					if (stats_.residentBytes_ + bytes > budget_) break;
+					Chunk& chunk = chunks_[request.second];
+					chunk.distance_ = request.first;
+					chunk.pendingLod_ = lod;
+					chunk.reserved_ = bytes;
+					stats_.residentBytes_ += bytes;
+					const ChunkKey key = request.second;
+					const Heightfield* heightfield = &heightfield_;
+					chunk.pending_ = workers_->Submit([heightfield, key, lod]() { return BuildChunk(*heightfield, key, lod); });
+					++jobsInFlight_;
+				}
+				stats_.pending_ = jobsInFlight_;
+				stats_.resident_ = 0;
+				for (const auto& entry : chunks_) stats_.resident_ += entry.second.lod_ >= 0;
+			}
+			// every resident chunk, stitched against the lods its neighbours have uploaded.
+			void Draw() {
+				glBindVertexArray(VAO_);
+				stats_.drawn_ = 0;
+				stats_.triangles_ = 0;
+				for (const auto& entry : chunks_) {
+					const Chunk& chunk = entry.second;
+					if (chunk.lod_ < 0) continue;
+					const ChunkKey& key = entry.first;
+					const std::array<ChunkKey, 4> neighbours = { ChunkKey{ key.x_ - 1, key.z_ }, ChunkKey{ key.x_ + 1, key.z_ }, ChunkKey{ key.x_, key.z_ - 1 }, ChunkKey{ key.x_, key.z_ + 1 } };
+					std::array<unsigned int, 4> steps;
+					for (unsigned int edge = 0; edge < 4; ++edge) {
+						auto neighbour = chunks_.find(neighbours[edge]);
+						const int neighbourLod = neighbour == chunks_.end() ? -1 : neighbour->second.lod_;
+						steps[edge] = neighbourLod > chunk.lod_ ? 1u << (neighbourLod - chunk.lod_) : 1u;
+					}
+					const IndexBuffer& indices = Indices(chunk.lod_, steps);
+					glBindBuffer(GL_ARRAY_BUFFER, chunk.vertexBuffer_);
+					glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::POSITION), 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (void*)offsetof(TerrainVertex, position_));
+					glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::NORMAL), 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (void*)offsetof(TerrainVertex, normal_));
+					glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.bufferID_);
+					glDrawElements(GL_TRIANGLES, indices.count_, GL_UNSIGNED_SHORT, (void*)0);
+					++stats_.drawn_;
+					stats_.triangles_ += indices.count_ / 3;
+				}
+				glBindVertexArray(0);
+			}
+			inline const TerrainStats& Stats() const noexcept { return stats_; }
+			inline void ResetCounters() noexcept {
+				stats_.uploads_ = 0;
+				stats_.evictions_ = 0;
+			}
+			inline float HeightAt(const float& x, const float& z) const { return heightfield_.Height(x, z); }
+		};
+	}
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+namespace nr {
+	namespace util {
+		// fixed set of workers pulling from one fifo queue. for coarse tasks like file reads, not fine grained jobs.
+		class ThreadPool {
+		private:
+			std::vector<std::thread> workers_;
+			std::deque<std::function<void()>> tasks_;
+			std::mutex mutex_;
+			std::condition_variable wake_;
+			bool stopping_{ false };
+
+			void Work() {
+				while (true) {
+					std::function<void()> task;
+					{
+						std::unique_lock<std::mutex> lock(mutex_);
+						wake_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+						if (tasks_.empty()) return;
+						task = std::move(tasks_.front());
+						tasks_.pop_front();
+					}
+					task();
+				}
+			}
+		public:
+			explicit ThreadPool(const unsigned int& threadCount = std::max(1u, std::thread::hardware_concurrency())) {
+				workers_.reserve(threadCount);
+				for (unsigned int i = 0; i < threadCount; ++i) workers_.emplace_back(&ThreadPool::Work, this);
+			}
+			ThreadPool(const ThreadPool&) = delete;
+			ThreadPool& operator=(const ThreadPool&) = delete;
+			// finishes whatever is queued before joining.
+			~ThreadPool() {
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					stopping_ = true;
+				}
+				wake_.notify_all();
+				for (std::thread& worker : workers_) worker.join();
+			}
+			// exceptions thrown by task come back out of the future's get().
+			template<typename Task>
+			auto Submit(Task&& task) -> std::future<decltype(task())> {
+				auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::forward<Task>(task));
+				std::future<decltype(task())> result = packaged->get_future();
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					tasks_.emplace_back([packaged]() { (*packaged)(); });
+				}
+				wake_.notify_one();
+				return result;
+			}
+			inline unsigned int Size() const noexcept { return workers_.size(); }
+		};
+		// for data parallel loops over big arrays, where ThreadPool's single queue would be contended.
+		// every thread has its own queue, ParallelFor deals the chunks out round robin, and a thread that
+		// runs dry steals from the front of the others', so uneven chunks still even out. the calling
+		// thread works too rather than waiting, so ParallelFor must only be called from one thread at a time.
+		class StealingPool {
+		private:
+			struct Queue {
+				std::mutex mutex_;
+				std::deque<std::function<void()>> tasks_;
+			};
+			// queue 0 belongs to the calling thread, the rest to the workers.
+			std::vector<std::unique_ptr<Queue>> queues_;
+			std::vector<std::thread> workers_;
+			std::mutex sleepMutex_;
+			std::condition_variable wake_;
+			// tasks pushed and not yet taken by anyone.
+			std::atomic<unsigned int> queued_{ 0 };
+			bool stopping_{ false };
+			std::atomic<unsigned int> steals_{ 0 };
+
+			bool RunOne(const unsigned int& self) {
+				std::function<void()> task;
+				// newest own task first, it is the likeliest to still be in cache.
+				{
+					Queue& queue = *queues_[self];
+					std::lock_guard<std::mutex> lock(queue.mutex_);
+					if (!queue.tasks_.empty()) {
+						task = std::move(queue.tasks_.back());
+						queue.tasks_.pop_back();
+					}
+				}
+				for (unsigned int i = 1; !task && i < queues_.size(); ++i) {
+					Queue& victim = *queues_[(self + i) % queues_.size()];
+					std::lock_guard<std::mutex> lock(victim.mutex_);
+					if (victim.tasks_.empty()) continue;
+					task = std::move(victim.tasks_.front());
+					victim.tasks_.pop_front();
+					steals_.fetch_add(1, std::memory_order_relaxed);
+				}
+				if (!task) return false;
+				queued_.fetch_sub(1, std::memory_order_relaxed);
+				task();
+				return true;
+			}
+			void Work(const unsigned int& self) {
+				while (true) {
+					if (RunOne(self)) continue;
+					std::unique_lock<std::mutex> lock(sleepMutex_);
+					wake_.wait(lock, [this]() { return stopping_ || queued_.load() > 0; });
+					if (stopping_) return;
+				}
+			}
+		public:
+			// workerCount threads besides the caller.
+			explicit StealingPool(const unsigned int& workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1) {
+				for (unsigned int i = 0; i <= workerCount; ++i) queues_.push_back(std::make_unique<Queue>());
+				workers_.reserve(workerCount);
+				for (unsigned int i = 1; i <= workerCount; ++i) workers_.emplace_back(&StealingPool::Work, this, i);
+			}
+			StealingPool(const StealingPool&) = delete;
+			StealingPool& operator=(const StealingPool&) = delete;
+			~StealingPool() {
+				{
+					std::lock_guard<std::mutex> lock(sleepMutex_);
+					stopping_ = true;
+				}
+				wake_.notify_all();
+				for (std::thread& worker : workers_) worker.join();
+			}
+			// body(begin, end) over [0, count) in chunks of grain, returning once every chunk has run.
+			template<typename Body>
+			void ParallelFor(const std::size_t& count, const std::size_t& grain, const Body& body) {
+				const std::size_t chunks = (count + grain - 1) / grain;
+				if (chunks <= 1 || workers_.empty()) {
+					for (std::size_t begin = 0; begin < count; begin += grain) body(begin, std::min(count, begin + grain));
+					return;
+				}
+				std::atomic<std::size_t> remaining{ chunks };
+				for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+					const std::size_t begin = chunk * grain;
+					const std::size_t end = std::min(count, begin + grain);
+					Queue& queue = *queues_[chunk % queues_.size()];
+					std::lock_guard<std::mutex> lock(queue.mutex_);
+					queue.tasks_.emplace_back([&body, &remaining, begin, end]() {
+						body(begin, end);
+						remaining.fetch_sub(1, std::memory_order_release);
+					});
+				}
+				{
+					std::lock_guard<std::mutex> lock(sleepMutex_);
+					queued_.fetch_add(chunks);
+				}
+				wake_.notify_all();
+				while (remaining.load(std::memory_order_acquire)) {
+					if (!RunOne(0)) std::this_thread::yield();
+				}
+			}
+			// threads working a ParallelFor, the caller included.
+			inline unsigned int Size() const noexcept { return queues_.size(); }
+			inline unsigned int Steals() const noexcept { return steals_.load(std::memory_order_relaxed); }
+		};
+	}
+}
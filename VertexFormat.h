@@ -0,0 +1,18 @@
+#pragma once
+#include <glad/glad.h>
+
+namespace nr {
+	namespace driver {
+		// shader input locations, shared by everything that sets up vertex arrays.
+		enum class VERTEXATTRIBUTE : GLuint {
+			POSITION = 0,
+			COLOR = 1,
+			VELOCITY = 2,
+			ANGLE = 3,
+			NORMAL = 4,
+			// age and lifetime, for particles simulated on the gpu.
+			LIFE = 5
+		};
+		const unsigned int ATTRIBUTECOUNT = 6;
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace nr {
+	namespace assets {
+		// a read-only file in memory. mapped where the platform allows it, so nothing is copied
+		// and the pages are shared with the os file cache. unmapped when the last reference goes.
+		// truncating a file while it is mapped faults on access, so hold assets only as long as needed.
+		class Asset {
+		private:
+			const char* data_{ nullptr };
+			std::size_t size_{ 0 };
+			// heap copy on platforms without mmap.
+			std::vector<char> buffer_;
+			bool mapped_{ false };
+		public:
+			Asset() = default;
+			Asset(const Asset&) = delete;
+			Asset& operator=(const Asset&) = delete;
+			~Asset() {
+#if defined(__unix__) || defined(__APPLE__)
+				if (mapped_) munmap(const_cast<char*>(data_), size_);
+#endif
+			}
+			bool Open(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+				const int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+				if (file < 0) return false;
+				struct stat info;
+				if (fstat(file, &info) != 0) {
+					close(file);
+					return false;
+				}
+				size_ = info.st_size;
+				// mmap refuses empty ranges, an empty file is just an empty view.
+				if (size_) {
+					void* mapping = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, file, 0);
+					mapped_ = mapping != MAP_FAILED;
+					if (mapped_) data_ = static_cast<const char*>(mapping);
+				}
+				close(file);
+				return !size_ || mapped_;
+#else
+				std::ifstream file(path, std::ios::binary | std::ios::ate);
+				if (!file) return false;
+				buffer_.resize(static_cast<std::size_t>(file.tellg()));
+				file.seekg(0);
+				if (!file.read(buffer_.data(), buffer_.size())) return false;
+				data_ = buffer_.data();
+				size_ = buffer_.size();
+				return true;
+#endif
+			}
+			// not null terminated.
+			inline std::string_view Text() const noexcept { return { data_, size_ }; }
+			inline const void* Data() const noexcept { return data_; }
+			inline std::size_t Size() const noexcept { return size_; }
+			// the file as an array of T, for binary mesh data.
+			template<typename T>
+			inline const T* As() const noexcept { return reinterpret_cast<const T*>(data_); }
+			template<typename T>
+			inline std::size_t Count() const noexcept { return size_ / sizeof(T); }
+		};
+
+		// hands out shared assets by path. a file already loaded is reused rather than mapped again,
+		// but the registry only holds weak references, so dropping every handle releases the mapping.
+		// safe to call from worker threads.
+		class AssetRegistry {
+		private:
+			std::unordered_map<std::string, std::weak_ptr<const Asset>> assets_;
+			std::mutex mutex_;
+			unsigned int loads_{ 0 };
+			unsigned int reuses_{ 0 };
+		public:
+			// null if the file cannot be read.
+			std::shared_ptr<const Asset> Load(const std::string& fileName) {
+				std::error_code error;
+				const std::string path = std::filesystem::absolute(fileName, error).lexically_normal().string();
+				std::lock_guard<std::mutex> lock(mutex_);
+				std::weak_ptr<const Asset>& entry = assets_[path];
+				if (std::shared_ptr<const Asset> asset = entry.lock()) {
+					++reuses_;
+					return asset;
+				}
+				auto asset = std::make_shared<Asset>();
+				if (!asset->Open(path)) {
+					std::cout << "assets: cannot read " << fileName << std::endl;
+					assets_.erase(path);
+					return nullptr;
+				}
+				++loads_;
+				entry = asset;
+				return asset;
+			}
+			// the next Load of this file reads it from disk again, for files changed since they were mapped.
+			// existing handles keep the mapping they have.
+			void Forget(const std::string& fileName) {
+				std::error_code error;
+				const std::string path = std::filesystem::absolute(fileName, error).lexically_normal().string();
+				std::lock_guard<std::mutex> lock(mutex_);
+				assets_.erase(path);
+			}
+			// files currently held by someone.
+			unsigned int Resident() {
+				std::lock_guard<std::mutex> lock(mutex_);
+				unsigned int resident = 0;
+				for (const auto& asset : assets_) resident += !asset.second.expired();
+				return resident;
+			}
+			unsigned int Loads() {
+				std::lock_guard<std::mutex> lock(mutex_);
+				return loads_;
+			}
+			unsigned int Reuses() {
+				std::lock_guard<std::mutex> lock(mutex_);
+				return reuses_;
+			}
+		};
+	}
+}
@@ -0,0 +1,241 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <type_traits>
+#include "Geometry.h"
+
+namespace nr {
+	namespace geometry {
+		// a shape's triangles inside a batch's index buffer.
+		struct Submesh {
+			unsigned int firstIndex_;
+			unsigned int indexCount_;
+		};
+		// post-transform cache efficiency. acmr: transformed vertices per triangle, atvr: per unique vertex. 1.0 atvr is ideal.
+		struct CacheStats {
+			float acmr_;
+			float atvr_;
+		};
+
+		// replays indices through a fifo cache the size of a typical post-transform cache.
+		inline CacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, const unsigned int& vertexCount, const unsigned int& cacheSize = 16) {
+			std::deque<unsigned int> cache;
+			std::vector<bool> inCache(vertexCount, false);
+			std::vector<bool> used(vertexCount, false);
+			unsigned int misses = 0;
+			unsigned int uniqueVertices = 0;
+			for (const unsigned int& index : indices) {
+				if (!used[index]) {
+					used[index] = true;
+					++uniqueVertices;
+				}
+				if (inCache[index]) continue;
+				++misses;
+				cache.push_back(index);
+				inCache[index] = true;
+				if (cache.size() > cacheSize) {
+					inCache[cache.front()] = false;
+					cache.pop_front();
+				}
+			}
+			const unsigned int triangles = indices.size() / 3;
+			return { triangles ? float(misses) / triangles : 0.0f, uniqueVertices ? float(misses) / uniqueVertices : 0.0f };
+		}
+
+		// tom forsyth's linear-speed vertex cache optimisation, applied to indices [first, first + count).
+		inline void OptimizeVertexCache(std::vector<unsigned int>& indices, const unsigned int& first, const unsigned int& count) {
+			const int CACHESIZE = 32;
+			const unsigned int triangleCount = count / 3;
+			if (triangleCount == 0) return;
+
+			// work in the range's own vertex ids, so cost scales with the range rather than the whole batch.
+			std::unordered_map<unsigned int, unsigned int> toLocal;
+			std::vector<unsigned int> toGlobal;
+			std::vector<unsigned int> local(count);
+			for (unsigned int i = 0; i < count; ++i) {
+				auto inserted = toLocal.emplace(indices[first + i], static_cast<unsigned int>(toGlobal.size()));
+				if (inserted.second) toGlobal.push_back(indices[first + i]);
+				local[i] = inserted.first->second;
+			}
+			const unsigned int vertexCount = toGlobal.size();
+
+			auto cacheScore = [CACHESIZE](const int& position) {
+				if (position < 0) return 0.0f;
+				// the last triangle's vertices score the same, so it isn't rewarded for its own order.
+				if (position < 3) return 0.75f;
+				return std::pow(1.0f - float(position - 3) / (CACHESIZE - 3), 1.5f);
+			};
+			auto valenceScore = [](const unsigned int& remaining) {
+				// favour vertices with few triangles left, so they can leave the cache for good.
+				return remaining ? 2.0f / std::sqrt(float(remaining)) : 0.0f;
+			};
+
+			// per-vertex adjacency, compressed into one array.
+			std::vector<unsigned int> remaining(vertexCount, 0);
+			for (unsigned int i = 0; i < count; ++i) ++remaining[local[i]];
+			std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+			for (unsigned int v = 0; v < vertexCount; ++v) adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+			std::vector<unsigned int> adjacency(count);
+			std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+			for (unsigned int t = 0; t < triangleCount; ++t) {
+				for (unsigned int k = 0; k < 3; ++k) adjacency[fill[local[t * 3 + k]]++] = t;
+			}
+
+			std::vector<float> vertexScore(vertexCount, 0.0f);
+			for (unsigned int v = 0; v < vertexCount; ++v) vertexScore[v] = valenceScore(remaining[v]);
+			std::vector<float> triangleScore(triangleCount, 0.0f);
+			std::vector<bool> emitted(triangleCount, false);
+			for (unsigned int t = 0; t < triangleCount; ++t) {
+				for (unsigned int k = 0; k < 3; ++k) triangleScore[t] += vertexScore[local[t * 3 + k]];
+			}
+
+			std::vector<unsigned int> output;
+			output.reserve(count);
+			std::vector<unsigned int> cache;
+			cache.reserve(CACHESIZE + 3);
+			unsigned int scanCursor = 0;
+			int best = -1;
+			float bestScore = -1.0f;
+			for (unsigned int t = 0; t < triangleCount; ++t) {
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+			while (output.size() < count) {
+				if (best < 0) {
+					// nothing in the cache touches an unemitted triangle, fall back to the next one in order.
+					while (emitted[scanCursor]) ++scanCursor;
+					best = scanCursor;
+				}
+				emitted[best] = true;
+				std::vector<unsigned int> newCache;
+				newCache.reserve(CACHESIZE + 3);
+				for (unsigned int k = 0; k < 3; ++k) {
+					const unsigned int v = local[best * 3 + k];
+					output.push_back(v);
+					newCache.push_back(v);
+					// drop the emitted triangle from the vertex's adjacency.
+					auto begin = adjacency.begin() + adjacencyOffset[v];
+					auto end = begin + remaining[v];
+					std::iter_swap(std::find(begin, end, static_cast<unsigned int>(best)), end - 1);
+					--remaining[v];
+				}
+				for (const unsigned int& v : cache) {
+					if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) newCache.push_back(v);
+				}
+				// evicted vertices keep only their valence score.
+				for (unsigned int i = CACHESIZE; i < newCache.size(); ++i) vertexScore[newCache[i]] = valenceScore(remaining[newCache[i]]);
+				if (newCache.size() > CACHESIZE) newCache.resize(CACHESIZE);
+				cache.swap(newCache);
+
+				// rescore the cached vertices, then every triangle they touch.
+				for (unsigned int i = 0; i < cache.size(); ++i) vertexScore[cache[i]] = cacheScore(i) + valenceScore(remaining[cache[i]]);
+				best = -1;
+				bestScore = -1.0f;
+				for (const unsigned int& v : cache) {
+					for (unsigned int a = 0; a < remaining[v]; ++a) {
+						const unsigned int t = adjacency[adjacencyOffset[v] + a];
+						float score = 0.0f;
+						for (unsigned int k = 0; k < 3; ++k) score += vertexScore[local[t * 3 + k]];
+						triangleScore[t] = score;
+						if (score > bestScore) {
+							bestScore = score;
+							best = t;
+						}
+					}
+				}
+			}
+			for (unsigned int i = 0; i < count; ++i) indices[first + i] = toGlobal[output[i]];
+		}
+
+		// merges static shapes into one welded, cache optimised vertex/index buffer pair.
+		template<typename VertexType>
+		class StaticBatch {
+		private:
+			struct VertexHash {
+				std::size_t operator()(const VertexType& vertex) const {
+					const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+					std::uint64_t hash = 14695981039346656037ull;
+					for (std::size_t i = 0; i < sizeof(VertexType); ++i) hash = (hash ^ bytes[i]) * 1099511628211ull;
+					return static_cast<std::size_t>(hash);
+				}
+			};
+			struct VertexEqual {
+				bool operator()(const VertexType& a, const VertexType& b) const {
+					return std::memcmp(&a, &b, sizeof(VertexType)) == 0;
+				}
+			};
+			std::unordered_map<VertexType, unsigned int, VertexHash, VertexEqual> weld_;
+			std::vector<VertexType> vertices_;
+			std::vector<unsigned int> indices_;
+			std::vector<std::uint16_t> shortIndices_;
+			std::vector<Submesh> submeshes_;
+			unsigned int inputVertexCount_{ 0 };
+		public:
+			// returns the shape's submesh id.
+			template<typename ShapeType>
+			unsigned int Add(const ShapeType& shape) {
+				static_assert(std::is_same<typename ShapeType::vertex_type, VertexType>::value, "shape vertex type differs from the batch");
+				std::vector<unsigned int> remap(shape.vertices.size());
+				for (unsigned int i = 0; i < shape.vertices.size(); ++i) {
+					auto inserted = weld_.emplace(shape.vertices[i], static_cast<unsigned int>(vertices_.size()));
+					if (inserted.second) vertices_.push_back(shape.vertices[i]);
+					remap[i] = inserted.first->second;
+				}
+				inputVertexCount_ += shape.vertices.size();
+				submeshes_.push_back({ static_cast<unsigned int>(indices_.size()), static_cast<unsigned int>(shape.indices.size()) });
+				for (const unsigned int& index : shape.indices) indices_.push_back(remap[index]);
+				return submeshes_.size() - 1;
+			}
+			void Build() {
+				const CacheStats before = AnalyzeVertexCache(indices_, vertices_.size());
+				weld_.clear();
+
+				// reorder within each submesh, so a submesh stays a contiguous range.
+				for (const Submesh& submesh : submeshes_) {
+					OptimizeVertexCache(indices_, submesh.firstIndex_, submesh.indexCount_);
+				}
+
+				// lay vertices out in first-use order so fetches walk the buffer linearly.
+				std::vector<unsigned int> remap(vertices_.size(), ~0u);
+				std::vector<VertexType> ordered;
+				ordered.reserve(vertices_.size());
+				for (unsigned int& index : indices_) {
+					if (remap[index] == ~0u) {
+						remap[index] = ordered.size();
+						ordered.push_back(vertices_[index]);
+					}
+					index = remap[index];
+				}
+				vertices_.swap(ordered);
+
+				if (IndexType() == GL_UNSIGNED_SHORT) shortIndices_.assign(indices_.begin(), indices_.end());
+				const CacheStats after = AnalyzeVertexCache(indices_, vertices_.size());
+				std::cout << "batch: " << submeshes_.size() << " shapes, " << vertices_.size() << " vertices (" << inputVertexCount_ << " before welding), "
+					<< indices_.size() / 3 << " triangles, " << (IndexType() == GL_UNSIGNED_SHORT ? 16 : 32) << " bit indices" << std::endl;
+				std::cout << "batch: acmr " << before.acmr_ << " -> " << after.acmr_ << ", atvr " << before.atvr_ << " -> " << after.atvr_ << std::endl;
+			}
+			inline GLenum IndexType() const noexcept {
+				return vertices_.size() <= 0xffff ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+			}
+			inline unsigned int IndexSize() const noexcept {
+				return IndexType() == GL_UNSIGNED_SHORT ? sizeof(std::uint16_t) : sizeof(unsigned int);
+			}
+			inline const void* IndexData() const noexcept {
+				return IndexType() == GL_UNSIGNED_SHORT ? static_cast<const void*>(shortIndices_.data()) : static_cast<const void*>(indices_.data());
+			}
+			inline unsigned int IndexCount() const noexcept { return indices_.size(); }
+			inline const std::vector<VertexType>& Vertices() const noexcept { return vertices_; }
+			inline const std::vector<unsigned int>& Indices() const noexcept { return indices_; }
+			inline const std::vector<Submesh>& Submeshes() const noexcept { return submeshes_; }
+		};
+	}
+}
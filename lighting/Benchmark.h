@@ -0,0 +1,149 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+#include <array>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <iostream>
+
+namespace nr {
+	namespace benchmark {
+		struct Summary {
+			double min_{ 0 };
+			double avg_{ 0 };
+			double p99_{ 0 };
+			double max_{ 0 };
+		};
+		inline Summary Summarize(std::vector<double> samples) {
+			if (samples.empty()) return {};
+			std::sort(samples.begin(), samples.end());
+			const std::size_t p99 = std::min(samples.size() - 1, static_cast<std::size_t>(samples.size() * 0.99));
+			return { samples.front(), std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size(), samples[p99], samples.back() };
+		}
+
+		// per-frame wall, cpu submission and gpu times, in milliseconds.
+		// gpu times come from GL_TIME_ELAPSED queries read back QUERYCOUNT - 1 frames late, so reading never waits on the gpu.
+		class FrameTimer {
+		private:
+			using Clock = std::chrono::steady_clock;
+			static const unsigned int QUERYCOUNT = 4;
+			std::array<GLuint, QUERYCOUNT> queries_;
+			unsigned int frame_{ 0 };
+			unsigned int collected_{ 0 };
+			Clock::time_point frameStart_;
+			Clock::time_point lastFrameStart_;
+			std::vector<double> wall_;
+			std::vector<double> cpu_;
+			std::vector<double> gpu_;
+
+			static inline double Milliseconds(const Clock::time_point& from, const Clock::time_point& to) {
+				return std::chrono::duration<double, std::milli>(to - from).count();
+			}
+			void Collect(const bool& wait) {
+				while (collected_ < frame_) {
+					const GLuint query = queries_[collected_ % QUERYCOUNT];
+					GLint available = GL_FALSE;
+					if (!wait) glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+					if (!wait && !available) return;
+					GLuint64 elapsed = 0;
+					glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+					gpu_.push_back(elapsed / 1e6);
+					++collected_;
+				}
+			}
+		public:
+			void Init() {
+				glGenQueries(QUERYCOUNT, queries_.data());
+			}
+			void BeginFrame() {
+				frameStart_ = Clock::now();
+				if (frame_) wall_.push_back(Milliseconds(lastFrameStart_, frameStart_));
+				lastFrameStart_ = frameStart_;
+				// the query is about to be reused, its result has to be in by now.
+				if (frame_ >= QUERYCOUNT) Collect(frame_ - collected_ >= QUERYCOUNT);
+				glBeginQuery(GL_TIME_ELAPSED, queries_[frame_ % QUERYCOUNT]);
+			}
+			void EndFrame() {
+				glEndQuery(GL_TIME_ELAPSED);
+				cpu_.push_back(Milliseconds(frameStart_, Clock::now()));
+				++frame_;
+				Collect(false);
+			}
+			// waits for the outstanding queries.
+			void Finish() {
+				Collect(true);
+			}
+			void Report(std::ostream& out) const {
+				auto line = [&out](const char* name, const Summary& summary) {
+					out << name << " min " << summary.min_ << " avg " << summary.avg_ << " p99 " << summary.p99_ << " max " << summary.max_ << " ms" << std::endl;
+				};
+				// the first frame pays for lazy shader compiles and driver warm up, leave it out.
+				auto steady = [](const std::vector<double>& samples) {
+					return Summarize(std::vector<double>(samples.begin() + std::min<std::size_t>(1, samples.size()), samples.end()));
+				};
+				out << "benchmark: " << frame_ << " frames" << std::endl;
+				line("wall ", steady(wall_));
+				line("cpu  ", steady(cpu_));
+				line("gpu  ", steady(gpu_));
+			}
+			// frame,cpu,gpu per row. the first frame has no wall time.
+			bool SaveCSV(const std::string& fileName) const {
+				std::ofstream file(fileName);
+				if (!file) return false;
+				file << "frame,wall_ms,cpu_ms,gpu_ms\n";
+				for (unsigned int i = 0; i < cpu_.size(); ++i) {
+					file << i << ',' << (i ? wall_[i - 1] : 0.0) << ',' << cpu_[i] << ',' << (i < gpu_.size() ? gpu_[i] : 0.0) << '\n';
+				}
+				return bool(file);
+			}
+		};
+
+		// fragments passing the depth test between Begin and End, that is fragments shaded, read back late the way
+		// FrameTimer reads its gpu times. over the window's pixel count it is the average overdraw.
+		class FragmentCounter {
+		private:
+			static const unsigned int QUERYCOUNT = 4;
+			std::array<GLuint, QUERYCOUNT> queries_;
+			unsigned int frame_{ 0 };
+			unsigned int collected_{ 0 };
+			GLuint64 fragments_{ 0 };
+			unsigned int frames_{ 0 };
+
+			void Collect(const bool& wait) {
+				while (collected_ < frame_) {
+					const GLuint query = queries_[collected_ % QUERYCOUNT];
+					GLint available = GL_FALSE;
+					if (!wait) glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+					if (!wait && !available) return;
+					GLuint64 fragments = 0;
+					glGetQueryObjectui64v(query, GL_QUERY_RESULT, &fragments);
+					fragments_ += fragments;
+					++frames_;
+					++collected_;
+				}
+			}
+		public:
+			void Init() {
+				glGenQueries(QUERYCOUNT, queries_.data());
+			}
+			void Begin() {
+				if (frame_ >= QUERYCOUNT) Collect(frame_ - collected_ >= QUERYCOUNT);
+				glBeginQuery(GL_SAMPLES_PASSED, queries_[frame_ % QUERYCOUNT]);
+			}
+			void End() {
+				glEndQuery(GL_SAMPLES_PASSED);
+				++frame_;
+				Collect(false);
+			}
+			// per frame, over the frames read back since the last Reset.
+			inline double Average() const noexcept { return frames_ ? double(fragments_) / frames_ : 0.0; }
+			inline void Reset() noexcept {
+				fragments_ = 0;
+				frames_ = 0;
+			}
+		};
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cmath>
+
+namespace nr {
+	namespace driver {
+		struct CameraPose {
+			glm::vec3 position_;
+			float yaw_;
+			float pitch_;
+		};
+		// one pose per frame. replaying a saved path makes runs comparable without any input.
+		class CameraPath {
+		private:
+			std::vector<CameraPose> poses_;
+		public:
+			inline void Record(const CameraPose& pose) {
+				poses_.push_back(pose);
+			}
+			// plain text, one "x y z yaw pitch" line per frame.
+			bool Save(const std::string& fileName) const {
+				std::ofstream file(fileName);
+				if (!file) return false;
+				for (const CameraPose& pose : poses_) {
+					file << pose.position_.x << ' ' << pose.position_.y << ' ' << pose.position_.z << ' ' << pose.yaw_ << ' ' << pose.pitch_ << '\n';
+				}
+				return bool(file);
+			}
+			bool Load(const std::string& fileName) {
+				std::ifstream file(fileName);
+				if (!file) return false;
+				poses_.clear();
+				CameraPose pose;
+				while (file >> pose.position_.x >> pose.position_.y >> pose.position_.z >> pose.yaw_ >> pose.pitch_) poses_.push_back(pose);
+				return !poses_.empty();
+			}
+			// a circle around center looking inwards, for runs without a recording.
+			static CameraPath Orbit(const glm::vec3& center, const float& radius, const float& height, const unsigned int& frameCount) {
+				CameraPath path;
+				for (unsigned int i = 0; i < frameCount; ++i) {
+					const float angle = 360.0f * i / frameCount;
+					const glm::vec3 position = center + glm::vec3(radius * std::cos(glm::radians(angle)), height, radius * std::sin(glm::radians(angle)));
+					const float pitch = glm::degrees(std::atan2(-height, radius));
+					path.Record({ position, angle + 180.0f, pitch });
+				}
+				return path;
+			}
+			// loops once the path runs out.
+			inline const CameraPose& At(const unsigned int& frame) const { return poses_[frame % poses_.size()]; }
+			inline bool Empty() const noexcept { return poses_.empty(); }
+			inline unsigned int Size() const noexcept { return poses_.size(); }
+		};
+	}
+}
@@ -0,0 +1,265 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include "StateCache.h"
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace nr {
+	namespace lighting {
+		struct PointLight {
+			glm::vec3 position_;
+			float radius_;
+			glm::vec3 color_;
+		};
+		struct ClusterStats {
+			unsigned int lights_{ 0 };
+			// lights touching at least one cluster.
+			unsigned int visible_{ 0 };
+			unsigned int references_{ 0 };
+			unsigned int busiestCluster_{ 0 };
+			// references past what the index buffer can hold, dropped.
+			unsigned int overflows_{ 0 };
+		};
+		// one frame's assignment, laid out the way the shaders read it.
+		struct ClusterLists {
+			// two texels a light: world position and radius, then color.
+			std::vector<glm::vec4> lights_;
+			// first index and count, per cluster.
+			std::vector<std::uint32_t> clusters_;
+			std::vector<std::uint16_t> indices_;
+			ClusterStats stats_;
+		};
+
+		// the view frustum cut into tiles on screen and exponential slices in depth. every frame each light's
+		// sphere is tested against the clusters its screen and depth extent could reach, a row of clusters at a
+		// time, and the hits become per-cluster index lists. fragments then only loop over their own cluster's.
+		class ClusterGrid {
+		public:
+			static constexpr unsigned int COUNTX = 16;
+			static constexpr unsigned int COUNTY = 16;
+			static constexpr unsigned int COUNTZ = 24;
+			static constexpr unsigned int CLUSTERCOUNT = COUNTX * COUNTY * COUNTZ;
+			// indices are 16 bit.
+			static constexpr unsigned int MAXLIGHTS = 1 << 16;
+			static_assert(COUNTX % 8 == 0, "rows are tested 8 clusters at a time");
+		private:
+			// view space bounds, a component per array so 8 neighbouring clusters load into one register.
+			alignas(32) std::array<float, CLUSTERCOUNT> minX_;
+			alignas(32) std::array<float, CLUSTERCOUNT> minY_;
+			alignas(32) std::array<float, CLUSTERCOUNT> minZ_;
+			alignas(32) std::array<float, CLUSTERCOUNT> maxX_;
+			alignas(32) std::array<float, CLUSTERCOUNT> maxY_;
+			alignas(32) std::array<float, CLUSTERCOUNT> maxZ_;
+			float near_{ 0.1f };
+			float far_{ 1.0f };
+			float tanX_{ 1.0f };
+			float tanY_{ 1.0f };
+			// slice = log(depth) * depthScale_ + depthBias_.
+			float depthScale_{ 1.0f };
+			float depthBias_{ 0.0f };
+			std::size_t maxReferences_{ 0 };
+			// cluster << 16 | light, in the order they were found.
+			std::vector<std::uint32_t> pairs_;
+			std::array<std::uint32_t, CLUSTERCOUNT> cursors_;
+
+			inline unsigned int Slice(const float& depth) const {
+				return static_cast<unsigned int>(std::min(std::max(std::log(depth) * depthScale_ + depthBias_, 0.0f), float(COUNTZ - 1)));
+			}
+			static inline unsigned int Tile(const float& ndc, const unsigned int& count) {
+				return static_cast<unsigned int>(std::min(std::max((ndc + 1.0f) * 0.5f * count, 0.0f), float(count - 1)));
+			}
+			// bit i set when the sphere reaches cluster first + i.
+			int Test(const unsigned int& first, const glm::vec3& center, const float& radius) const {
+#if defined(__AVX__)
+				const __m256 zero = _mm256_setzero_ps();
+				auto axis = [&zero](const float* min, const float* max, const float& center) {
+					const __m256 c = _mm256_set1_ps(center);
+					const __m256 distance = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(min), c), _mm256_sub_ps(c, _mm256_loadu_ps(max))), zero);
+					return _mm256_mul_ps(distance, distance);
+				};
+				const __m256 distance = _mm256_add_ps(_mm256_add_ps(
+					axis(&minX_[first], &maxX_[first], center.x),
+					axis(&minY_[first], &maxY_[first], center.y)),
+					axis(&minZ_[first], &maxZ_[first], center.z));
+				return _mm256_movemask_ps(_mm256_cmp_ps(distance, _mm256_set1_ps(radius * radius), _CMP_LE_OQ));
+#else
+				int mask = 0;
+				for (unsigned int i = 0; i < 8; ++i) {
+					const unsigned int cluster = first + i;
+					const glm::vec3 nearest = glm::max(glm::vec3(minX_[cluster], minY_[cluster], minZ_[cluster]), glm::min(center, glm::vec3(maxX_[cluster], maxY_[cluster], maxZ_[cluster])));
+					const glm::vec3 offset = nearest - center;
+					if (glm::dot(offset, offset) <= radius * radius) mask |= 1 << i;
+				}
+				return mask;
+#endif
+			}
+		public:
+			// the projection the lists will be used with. maxReferences caps the index list, see ClusterBuffers::MaxTexels.
+			void Init(const float& fovy, const float& aspect, const float& near, const float& far, const std::size_t& maxReferences) {
+				near_ = near;
+				far_ = far;
+				tanY_ = std::tan(fovy * 0.5f);
+				tanX_ = tanY_ * aspect;
+				depthScale_ = COUNTZ / std::log(far / near);
+				depthBias_ = -std::log(near) * depthScale_;
+				maxReferences_ = maxReferences;
+				for (unsigned int z = 0; z < COUNTZ; ++z) {
+					const float sliceNear = near * std::pow(far / near, float(z) / COUNTZ);
+					const float sliceFar = near * std::pow(far / near, float(z + 1) / COUNTZ);
+					for (unsigned int y = 0; y < COUNTY; ++y) {
+						const float bottom = -1.0f + 2.0f * y / COUNTY;
+						const float top = -1.0f + 2.0f * (y + 1) / COUNTY;
+						for (unsigned int x = 0; x < COUNTX; ++x) {
+							const float left = -1.0f + 2.0f * x / COUNTX;
+							const float right = -1.0f + 2.0f * (x + 1) / COUNTX;
+							const unsigned int cluster = (z * COUNTY + y) * COUNTX + x;
+							// the widest point of a tile's edge is at whichever end of the slice is further away.
+							minX_[cluster] = std::min(left * sliceNear, left * sliceFar) * tanX_;
+							maxX_[cluster] = std::max(right * sliceNear, right * sliceFar) * tanX_;
+							minY_[cluster] = std::min(bottom * sliceNear, bottom * sliceFar) * tanY_;
+							maxY_[cluster] = std::max(top * sliceNear, top * sliceFar) * tanY_;
+							// view space looks down -z.
+							minZ_[cluster] = -sliceFar;
+							maxZ_[cluster] = -sliceNear;
+						}
+					}
+				}
+			}
+			// lights past MAXLIGHTS are ignored.
+			void Assign(const std::vector<PointLight>& lights, const glm::mat4& viewMatrix, ClusterLists& lists) {
+				const unsigned int lightCount = std::min<std::size_t>(lights.size(), MAXLIGHTS);
+				ClusterStats& stats = lists.stats_;
+				stats = {};
+				stats.lights_ = lightCount;
+				lists.lights_.resize(lightCount * 2);
+				pairs_.clear();
+				for (unsigned int light = 0; light < lightCount; ++light) {
+					const PointLight& pointLight = lights[light];
+					const float radius = pointLight.radius_;
+					lists.lights_[light * 2] = glm::vec4(pointLight.position_, radius);
+					lists.lights_[light * 2 + 1] = glm::vec4(pointLight.color_, 1.0f);
+
+					const glm::vec3 center(viewMatrix * glm::vec4(pointLight.position_, 1.0f));
+					const float depth = -center.z;
+					if (depth + radius < near_ || depth - radius > far_) continue;
+					const float nearest = std::max(depth - radius, near_);
+					const float furthest = std::min(depth + radius, far_);
+					// the sphere's box projected at whichever depth in its range puts each edge furthest out.
+					const float left = center.x - radius;
+					const float right = center.x + radius;
+					const float bottom = center.y - radius;
+					const float top = center.y + radius;
+					const float leftNDC = left / ((left < 0.0f ? nearest : furthest) * tanX_);
+					const float rightNDC = right / ((right > 0.0f ? nearest : furthest) * tanX_);
+					const float bottomNDC = bottom / ((bottom < 0.0f ? nearest : furthest) * tanY_);
+					const float topNDC = top / ((top > 0.0f ? nearest : furthest) * tanY_);
+					if (rightNDC < -1.0f || leftNDC > 1.0f || topNDC < -1.0f || bottomNDC > 1.0f) continue;
+
+					const unsigned int x0 = Tile(leftNDC, COUNTX), x1 = Tile(rightNDC, COUNTX);
+					const unsigned int y0 = Tile(bottomNDC, COUNTY), y1 = Tile(topNDC, COUNTY);
+					const unsigned int z0 = Slice(nearest), z1 = Slice(furthest);
+					const std::size_t found = pairs_.size();
+					for (unsigned int z = z0; z <= z1; ++z) {
+						for (unsigned int y = y0; y <= y1; ++y) {
+							const unsigned int row = (z * COUNTY + y) * COUNTX;
+							for (unsigned int x = x0 & ~7u; x <= x1; x += 8) {
+								// only the tiles in range, the rest of the 8 were never candidates.
+								const unsigned int first = std::max(x0, x) - x;
+								const unsigned int last = std::min(x1, x + 7) - x;
+								const int mask = Test(row + x, center, radius);
+								for (unsigned int bit = first; bit <= last; ++bit) {
+									if (mask & (1 << bit)) pairs_.push_back((row + x + bit) << 16 | light);
+								}
+							}
+						}
+					}
+					stats.visible_ += pairs_.size() != found;
+				}
+
+				// counting sort by cluster. stable, so each cluster's lights stay in light order.
+				lists.clusters_.assign(CLUSTERCOUNT * 2, 0);
+				for (const std::uint32_t& pair : pairs_) ++lists.clusters_[(pair >> 16) * 2 + 1];
+				std::uint32_t offset = 0;
+				for (unsigned int cluster = 0; cluster < CLUSTERCOUNT; ++cluster) {
+					std::uint32_t& count = lists.clusters_[cluster * 2 + 1];
+					stats.busiestCluster_ = std::max(stats.busiestCluster_, count);
+					const std::uint32_t kept = std::min<std::size_t>(count, maxReferences_ - offset);
+					stats.overflows_ += count - kept;
+					count = kept;
+					lists.clusters_[cluster * 2] = offset;
+					cursors_[cluster] = offset;
+					offset += kept;
+				}
+				stats.references_ = offset;
+				lists.indices_.resize(offset);
+				for (const std::uint32_t& pair : pairs_) {
+					const std::uint32_t cluster = pair >> 16;
+					std::uint32_t& cursor = cursors_[cluster];
+					if (cursor == lists.clusters_[cluster * 2] + lists.clusters_[cluster * 2 + 1]) continue;
+					lists.indices_[cursor++] = static_cast<std::uint16_t>(pair & 0xFFFF);
+				}
+			}
+			// what the fragment shader needs to find its cluster: tiles per pixel, then depth scale and bias.
+			inline glm::vec3 Counts() const noexcept { return glm::vec3(COUNTX, COUNTY, COUNTZ); }
+			inline glm::vec3 Scale(const unsigned int& width, const unsigned int& height) const noexcept {
+				return glm::vec3(float(COUNTX) / width, float(COUNTY) / height, depthScale_);
+			}
+			inline float DepthBias() const noexcept { return depthBias_; }
+		};
+
+		// the lists as three texture buffers. glsl 330 has no storage buffers, and no glTexBufferRange to
+		// point a texture into a stream, so each upload orphans its buffer instead.
+		class ClusterBuffers {
+		private:
+			enum BUFFER { LIGHTS, CLUSTERS, INDICES, BUFFERCOUNT };
+			std::array<GLuint, BUFFERCOUNT> buffers_{};
+			std::array<GLuint, BUFFERCOUNT> textures_{};
+
+			void Upload(const BUFFER& buffer, const void* data, const GLsizeiptr& size) {
+				nr::driver::glState_.BindBuffer(GL_TEXTURE_BUFFER, buffers_[buffer]);
+				// never empty, a texture over a zero sized buffer is incomplete.
+				glBufferData(GL_TEXTURE_BUFFER, std::max<GLsizeiptr>(size, 16), NULL, GL_STREAM_DRAW);
+				if (size) glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+			}
+		public:
+			// texels the index buffer can address.
+			static std::size_t MaxTexels() {
+				GLint texels = 0;
+				glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+				return texels;
+			}
+			void Init() {
+				glGenBuffers(BUFFERCOUNT, buffers_.data());
+				glGenTextures(BUFFERCOUNT, textures_.data());
+				const std::array<GLenum, BUFFERCOUNT> formats = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+				for (unsigned int i = 0; i < BUFFERCOUNT; ++i) {
+					Upload(static_cast<BUFFER>(i), nullptr, 0);
+					glBindTexture(GL_TEXTURE_BUFFER, textures_[i]);
+					glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers_[i]);
+				}
+				glBindTexture(GL_TEXTURE_BUFFER, 0);
+			}
+			void Upload(const ClusterLists& lists) {
+				Upload(LIGHTS, lists.lights_.data(), lists.lights_.size() * sizeof(glm::vec4));
+				Upload(CLUSTERS, lists.clusters_.data(), lists.clusters_.size() * sizeof(std::uint32_t));
+				Upload(INDICES, lists.indices_.data(), lists.indices_.size() * sizeof(std::uint16_t));
+			}
+			// lights, clusters and indices on three units from firstUnit.
+			void Bind(const GLuint& firstUnit) const {
+				for (unsigned int i = 0; i < BUFFERCOUNT; ++i) {
+					glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+					glBindTexture(GL_TEXTURE_BUFFER, textures_[i]);
+				}
+				glActiveTexture(GL_TEXTURE0);
+			}
+		};
+	}
+}
@@ -0,0 +1,188 @@
+#pragma once
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include "Geometry.h"
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace nr {
+	namespace culling {
+		enum class CULLRESULT {
+			OUTSIDE,
+			INTERSECTING,
+			INSIDE
+		};
+		struct CullStats {
+			unsigned int visible_{ 0 };
+			unsigned int culled_{ 0 };
+			unsigned int tests_{ 0 };
+		};
+
+		// frustum planes stored a component per array, so one register holds the same component of several planes.
+		// the 6 planes are padded to 8 with (0,0,0,1), which every box is inside of.
+		class Frustum {
+		private:
+			alignas(32) std::array<float, 8> x_;
+			alignas(32) std::array<float, 8> y_;
+			alignas(32) std::array<float, 8> z_;
+			alignas(32) std::array<float, 8> w_;
+			// |normal|, the box extent projected onto each plane normal.
+			alignas(32) std::array<float, 8> absX_;
+			alignas(32) std::array<float, 8> absY_;
+			alignas(32) std::array<float, 8> absZ_;
+		public:
+			// gribb/hartmann extraction from a (projection * view) matrix. planes face inwards.
+			void Extract(const glm::mat4& viewProjection) {
+				auto row = [&viewProjection](const int& i) {
+					return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+				};
+				const std::array<glm::vec4, 6> planes = {
+					row(3) + row(0), row(3) - row(0),
+					row(3) + row(1), row(3) - row(1),
+					row(3) + row(2), row(3) - row(2)
+				};
+				for (unsigned int i = 0; i < 8; ++i) {
+					glm::vec4 plane = i < planes.size() ? planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+					const float length = glm::length(glm::vec3(plane.x, plane.y, plane.z));
+					if (length > 0.0f) plane = plane / length;
+					x_[i] = plane.x;
+					y_[i] = plane.y;
+					z_[i] = plane.z;
+					w_[i] = plane.w;
+					absX_[i] = std::abs(plane.x);
+					absY_[i] = std::abs(plane.y);
+					absZ_[i] = std::abs(plane.z);
+				}
+			}
+			CULLRESULT Test(const nr::geometry::AABB& box) const {
+				const glm::vec3 center = box.Center();
+				const glm::vec3 extent = box.Extent();
+				int outside = 0;
+				int intersecting = 0;
+#if defined(__AVX__)
+				const __m256 distance = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(_mm256_load_ps(x_.data()), _mm256_set1_ps(center.x)),
+					_mm256_mul_ps(_mm256_load_ps(y_.data()), _mm256_set1_ps(center.y))),
+					_mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(z_.data()), _mm256_set1_ps(center.z)), _mm256_load_ps(w_.data())));
+				const __m256 radius = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(_mm256_load_ps(absX_.data()), _mm256_set1_ps(extent.x)),
+					_mm256_mul_ps(_mm256_load_ps(absY_.data()), _mm256_set1_ps(extent.y))),
+					_mm256_mul_ps(_mm256_load_ps(absZ_.data()), _mm256_set1_ps(extent.z)));
+				outside = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+				intersecting = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_sub_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+#elif defined(__SSE2__) || defined(_M_X64)
+				for (unsigned int i = 0; i < 8; i += 4) {
+					const __m128 distance = _mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(_mm_load_ps(x_.data() + i), _mm_set1_ps(center.x)),
+						_mm_mul_ps(_mm_load_ps(y_.data() + i), _mm_set1_ps(center.y))),
+						_mm_add_ps(_mm_mul_ps(_mm_load_ps(z_.data() + i), _mm_set1_ps(center.z)), _mm_load_ps(w_.data() + i)));
+					const __m128 radius = _mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(_mm_load_ps(absX_.data() + i), _mm_set1_ps(extent.x)),
+						_mm_mul_ps(_mm_load_ps(absY_.data() + i), _mm_set1_ps(extent.y))),
+						_mm_mul_ps(_mm_load_ps(absZ_.data() + i), _mm_set1_ps(extent.z)));
+					outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+					intersecting |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+				}
+#else
+				for (unsigned int i = 0; i < 6; ++i) {
+					const float distance = x_[i] * center.x + y_[i] * center.y + z_[i] * center.z + w_[i];
+					const float radius = absX_[i] * extent.x + absY_[i] * extent.y + absZ_[i] * extent.z;
+					outside |= distance + radius < 0.0f;
+					intersecting |= distance - radius < 0.0f;
+				}
+#endif
+				if (outside) return CULLRESULT::OUTSIDE;
+				return intersecting ? CULLRESULT::INTERSECTING : CULLRESULT::INSIDE;
+			}
+		};
+
+		// bounding volume hierarchy over item boxes. every node covers a contiguous run of items_,
+		// so a node entirely inside the frustum is accepted without visiting its children.
+		class BVH {
+		private:
+			struct Node {
+				nr::geometry::AABB bounds_;
+				unsigned int first_;
+				unsigned int count_;
+				// 0 for leaves. the left child always directly follows its parent.
+				unsigned int right_;
+			};
+			static const unsigned int LEAFSIZE = 4;
+			std::vector<Node> nodes_;
+			std::vector<unsigned int> items_;
+			std::vector<nr::geometry::AABB> bounds_;
+
+			unsigned int BuildNode(const unsigned int& first, const unsigned int& count) {
+				const unsigned int index = nodes_.size();
+				nodes_.push_back({ {}, first, count, 0 });
+				nr::geometry::AABB bounds;
+				nr::geometry::AABB centers;
+				for (unsigned int i = first; i < first + count; ++i) {
+					bounds.Grow(bounds_[items_[i]]);
+					centers.Grow(bounds_[items_[i]].Center());
+				}
+				nodes_[index].bounds_ = bounds;
+				if (count <= LEAFSIZE) return index;
+
+				// median split along the widest axis of the centers.
+				const glm::vec3 spread = centers.max_ - centers.min_;
+				const int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+				const unsigned int half = count / 2;
+				std::nth_element(items_.begin() + first, items_.begin() + first + half, items_.begin() + first + count, [this, axis](const unsigned int& a, const unsigned int& b) {
+					return bounds_[a].Center()[axis] < bounds_[b].Center()[axis];
+					});
+				BuildNode(first, half);
+				const unsigned int right = BuildNode(first + half, count - half);
+				nodes_[index].right_ = right;
+				return index;
+			}
+		public:
+			void Build(const std::vector<nr::geometry::AABB>& bounds) {
+				bounds_ = bounds;
+				items_.resize(bounds_.size());
+				for (unsigned int i = 0; i < items_.size(); ++i) items_[i] = i;
+				nodes_.clear();
+				nodes_.reserve(2 * bounds_.size() / LEAFSIZE + 1);
+				if (!bounds_.empty()) BuildNode(0, bounds_.size());
+			}
+			// appends the indices of items intersecting the frustum to visible.
+			void Cull(const Frustum& frustum, std::vector<unsigned int>& visible, CullStats& stats) const {
+				const std::size_t visibleBefore = visible.size();
+				if (!nodes_.empty()) {
+					unsigned int stack[64];
+					unsigned int stackSize = 0;
+					stack[stackSize++] = 0;
+					while (stackSize) {
+						const Node& node = nodes_[stack[--stackSize]];
+						++stats.tests_;
+						const CULLRESULT result = frustum.Test(node.bounds_);
+						if (result == CULLRESULT::OUTSIDE) continue;
+						if (result == CULLRESULT::INSIDE) {
+							visible.insert(visible.end(), items_.begin() + node.first_, items_.begin() + node.first_ + node.count_);
+							continue;
+						}
+						if (node.right_) {
+							stack[stackSize++] = node.right_;
+							stack[stackSize++] = static_cast<unsigned int>(&node - nodes_.data()) + 1;
+							continue;
+						}
+						for (unsigned int i = node.first_; i < node.first_ + node.count_; ++i) {
+							++stats.tests_;
+							if (frustum.Test(bounds_[items_[i]]) != CULLRESULT::OUTSIDE) visible.push_back(items_[i]);
+						}
+					}
+				}
+				const unsigned int visibleCount = visible.size() - visibleBefore;
+				stats.visible_ += visibleCount;
+				stats.culled_ += bounds_.size() - visibleCount;
+			}
+			inline unsigned int ItemCount() const noexcept { return bounds_.size(); }
+			inline const nr::geometry::AABB& Bounds(const unsigned int& item) const { return bounds_[item]; }
+		};
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <glad/glad.h>
+#include <array>
+#include <iostream>
+
+namespace nr {
+	namespace lighting {
+		// what the deferred geometry pass writes, 12 bytes a pixel:
+		//   albedo  RGBA8     surface color, ambient scale in alpha
+		//   normal  RGB10_A2  octahedral normal in red and green, alpha 0 for surfaces that emit rather than reflect
+		//   depth   24 bit    world positions are rebuilt from it with the inverse view projection. stored with 8 bits of
+		//                     stencil, as the default framebuffer's is, so it can be blitted there
+		class GBuffer {
+		private:
+			enum TARGET { ALBEDO, NORMAL, DEPTH, TARGETCOUNT };
+			GLuint framebuffer_{ 0 };
+			std::array<GLuint, TARGETCOUNT> textures_{};
+			GLsizei width_{ 0 };
+			GLsizei height_{ 0 };
+		public:
+			static constexpr unsigned int BYTESPERPIXEL = 12;
+			// leaves the g-buffer bound. false if the driver will not render to it.
+			bool Init(const GLsizei& width, const GLsizei& height) {
+				width_ = width;
+				height_ = height;
+				struct Format {
+					GLenum internalFormat_;
+					GLenum format_;
+					GLenum type_;
+					GLenum attachment_;
+				};
+				const std::array<Format, TARGETCOUNT> formats = { {
+					{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT0 },
+					{ GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, GL_COLOR_ATTACHMENT1 },
+					{ GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_DEPTH_STENCIL_ATTACHMENT }
+				} };
+				glGenFramebuffers(1, &framebuffer_);
+				glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+				glGenTextures(TARGETCOUNT, textures_.data());
+				for (unsigned int i = 0; i < TARGETCOUNT; ++i) {
+					const Format& format = formats[i];
+					glBindTexture(GL_TEXTURE_2D, textures_[i]);
+					glTexImage2D(GL_TEXTURE_2D, 0, format.internalFormat_, width, height, 0, format.format_, format.type_, NULL);
+					// only ever read with texelFetch, but an incomplete mip chain would still make the texture incomplete.
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+					glFramebufferTexture2D(GL_FRAMEBUFFER, format.attachment_, GL_TEXTURE_2D, textures_[i], 0);
+				}
+				glBindTexture(GL_TEXTURE_2D, 0);
+				const std::array<GLenum, 2> drawBuffers = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+				glDrawBuffers(drawBuffers.size(), drawBuffers.data());
+				const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+				if (status != GL_FRAMEBUFFER_COMPLETE) std::cout << "g-buffer incomplete: " << std::hex << status << std::dec << std::endl;
+				return status == GL_FRAMEBUFFER_COMPLETE;
+			}
+			inline void Bind() const { glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_); }
+			// copies depth into target, which has to match the g-buffer's size and depth format, and leaves target bound.
+			void BlitDepth(const GLuint& target) const {
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+				glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+				glBindFramebuffer(GL_FRAMEBUFFER, target);
+			}
+			// albedo, normal and depth on three units from firstUnit.
+			void BindTextures(const GLuint& firstUnit) const {
+				for (unsigned int i = 0; i < TARGETCOUNT; ++i) {
+					glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+					glBindTexture(GL_TEXTURE_2D, textures_[i]);
+				}
+				glActiveTexture(GL_TEXTURE0);
+			}
+			inline GLsizei Width() const noexcept { return width_; }
+			inline GLsizei Height() const noexcept { return height_; }
+		};
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace nr {
+	namespace driver {
+		// single producer, single consumer ring. neither side ever blocks or locks: a full queue refuses the push.
+		template<typename T, std::size_t CAPACITY>
+		class InputQueue {
+		private:
+			std::array<T, CAPACITY> items_;
+			// on separate cache lines, each is written by one side only.
+			alignas(64) std::atomic<std::size_t> head_{ 0 };
+			alignas(64) std::atomic<std::size_t> tail_{ 0 };
+		public:
+			// producer side.
+			bool Push(const T& item) {
+				const std::size_t tail = tail_.load(std::memory_order_relaxed);
+				if (tail - head_.load(std::memory_order_acquire) == CAPACITY) return false;
+				items_[tail % CAPACITY] = item;
+				tail_.store(tail + 1, std::memory_order_release);
+				return true;
+			}
+			// consumer side.
+			bool Pop(T& item) {
+				const std::size_t head = head_.load(std::memory_order_relaxed);
+				if (head == tail_.load(std::memory_order_acquire)) return false;
+				item = items_[head % CAPACITY];
+				head_.store(head + 1, std::memory_order_release);
+				return true;
+			}
+		};
+
+		// hands whole values from one thread to another without either waiting. the writer fills Back() and
+		// publishes it, the reader picks up the newest published value with Acquire() and reads Front().
+		// three slots, so the writer always has one the reader is not looking at. a value published twice
+		// before the reader gets to it is simply replaced. slots are reused, so containers in T keep their capacity.
+		template<typename T>
+		class SnapshotBuffer {
+		private:
+			// set on the middle index while it holds a value the reader has not taken.
+			static const unsigned int FRESH = 4;
+			std::array<T, 3> slots_;
+			unsigned int back_{ 0 };
+			std::atomic<unsigned int> middle_{ 1 };
+			unsigned int front_{ 2 };
+		public:
+			// writer side.
+			inline T& Back() noexcept { return slots_[back_]; }
+			inline void Publish() noexcept {
+				back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) & ~FRESH;
+			}
+			// reader side. false when nothing new was published, Front() is then the same value as before.
+			inline bool Acquire() noexcept {
+				if (!(middle_.load(std::memory_order_relaxed) & FRESH)) return false;
+				front_ = middle_.exchange(front_, std::memory_order_acq_rel) & ~FRESH;
+				return true;
+			}
+			inline const T& Front() const noexcept { return slots_[front_]; }
+		};
+	}
+}
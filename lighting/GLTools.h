@@ -6,26 +6,48 @@
 #include <iostream>
 #include <string>
 #include <fstream>
-#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <chrono>
 #include "HSV.h"
 #include "Geometry.h"
 #include <algorithm>
 #include "LightSource.h"
+#include "UniformBuffer.h"
+#include "Batcher.h"
+#include "Culling.h"
+#include "Headless.h"
+#include "CameraPath.h"
+#include "Benchmark.h"
+#include "Profiler.h"
+#include "ProgramCache.h"
+#include "ThreadPool.h"
+#include "ShaderWatcher.h"
+#include "Assets.h"
+#include "FramePipeline.h"
+#include "RenderQueue.h"
+#include "StateCache.h"
+#include "Clusters.h"
+#include "Deferred.h"
+#include "Occlusion.h"
+#include "Simplify.h"
+#include <thread>
+#include <atomic>
 
 
 
 
 namespace nr {
 	namespace util {
-		std::string ReadFile(const std::string& fileName) {
-			std::string srcCode;
-			std::ifstream vShaderFile;
-			vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-			vShaderFile.open(fileName);
-			std::stringstream vShaderStream, fShaderStream;
-			vShaderStream << vShaderFile.rdbuf();
-			vShaderFile.close();
-			return vShaderStream.str();
+		// seconds since the first call. steady, and unlike glfwGetTime needs no window.
+		double GetElapsedTime() {
+			static const auto start = std::chrono::steady_clock::now();
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		// fnv-1a. constexpr so names can be hashed at compile time.
+		constexpr std::uint32_t Hash(const char* str, std::uint32_t hash = 2166136261u) {
+			return *str ? Hash(str + 1, (hash ^ static_cast<unsigned char>(*str)) * 16777619u) : hash;
 		}
 	}
 	namespace driver {
@@ -34,11 +56,80 @@ namespace nr {
 		const unsigned int WINDOWHEIGHT = 500;
 		bool wireframeMode_ = false;
 		bool mouseActive_ = true;
-		enum class VERTEXATTRIBUTE : GLuint {
-			POSITION = 0,
-			COLOR = 1,
-			NORMAL
-		};
+		bool printStats_ = false;
+		const unsigned int STATSINTERVAL = 600;
+		// spawns a grid of instanced cubes and reports frame times.
+		bool stressMode_ = false;
+		glm::uvec3 stressGrid_{ 100, 10, 100 };
+		// between neighbouring cubes' centers. 1 packs the grid into a solid block.
+		float stressSpacing_ = 2.0f;
+		// runs a wave through the stress grid, rewriting every instance each frame.
+		bool animateInstances_ = false;
+		// static cubes merged into the batch.
+		glm::uvec3 sceneGrid_{ 1, 1, 1 };
+		// render offscreen through egl for benchmarkFrames_ frames, no window.
+		bool headless_ = false;
+		// collect frame timings and report min/avg/p99 on exit. always on when headless.
+		bool benchmark_ = false;
+		unsigned int benchmarkFrames_ = 1000;
+		std::string benchmarkOutput_;
+		// replays this path, or records into it when recordCameraPath_ is set.
+		std::string cameraPathFile_;
+		bool recordCameraPath_ = false;
+		// what "the screen" is: 0 for the window, the offscreen fbo when headless.
+		GLuint defaultFramebuffer_ = 0;
+		// what is rendered to, in pixels. a window's can differ from the size asked for on high dpi screens.
+		glm::uvec2 framebufferSize_{ WINDOWWIDTH, WINDOWHEIGHT };
+		// chrome trace written on exit when built with NR_PROFILE.
+		std::string profileTraceFile_ = "profile.json";
+		// linked program binaries are kept here between runs. empty turns the cache off.
+		std::string programCacheDirectory_ = "programcache";
+		nr::driver::ProgramCache programCache_;
+		// shader sources and other files, mapped rather than copied. declared before workers_, which load into it.
+		nr::assets::AssetRegistry assets_;
+		// background work that does not touch gl, such as reading shader sources.
+		nr::util::ThreadPool workers_;
+		// relink programs whose shader files change on disk. off when headless.
+		bool hotReload_ = true;
+		nr::driver::ShaderWatcher shaderWatcher_;
+		// simulate at a fixed rate on a thread of its own while Render draws the newest snapshot it produced.
+		// off when headless, so benchmark frames are reproducible: every frame then runs exactly one tick.
+		bool pipelined_ = true;
+		const double TICKLENGTH = 1.0 / 60.0;
+		// ticks a late simulation may run back to back before it gives up catching up.
+		const unsigned int MAXCATCHUP = 5;
+		// order each frame's draws by state before issuing them. off draws them in the order the code adds them.
+		bool sortDraws_ = true;
+		// cubes drawn one call each over several programs, vaos and materials, for measuring the draw queue.
+		unsigned int looseProps_ = 0;
+		// point lights wandering over the scene, shaded through the cluster grid.
+		unsigned int pointLightCount_ = 0;
+		// the cluster texture buffers take this unit and the two after it.
+		const GLuint CLUSTERTEXTUREUNIT = 0;
+		// light through a g-buffer and per light volumes instead of fragmentShader.frag. chosen at startup.
+		bool deferredShading_ = false;
+		// the g-buffer textures take this unit and the two after it.
+		const GLuint GBUFFERTEXTUREUNIT = 3;
+		// lays depth down with a trivial program first, nearest first, then shades only the fragment that won with GL_EQUAL.
+		bool depthPrePass_ = false;
+		// orders the stress grid's instances nearest first every snapshot. streams them, so a static grid pays an upload a frame.
+		bool sortInstances_ = false;
+		// counts the fragments the scene pass shades, reported with the stats.
+		bool countOverdraw_ = false;
+		// shades every fragment as a faint additive step instead of lighting it, so overdraw shows as brightness.
+		bool overdrawView_ = false;
+		// drops shapes and instances hidden behind the cubes that look biggest, tested against a depth buffer
+		// rasterized on the cpu. frustum culls instances too, and streams them as sortInstances_ does.
+		bool occlusionCulling_ = false;
+		unsigned int occluderCount_ = 256;
+		glm::uvec2 occlusionResolution_{ 256, 128 };
+		// lit spheres spread out to different distances, each drawn at the coarsest level of detail whose error
+		// stays under lodPixelError_ pixels on screen. meshLOD_ off draws them all at full detail.
+		unsigned int lodProps_ = 0;
+		bool meshLOD_ = true;
+		float lodPixelError_ = 1.0f;
+		// a coarser level must fit within this share of lodPixelError_, so a sphere at a threshold does not flicker between two.
+		const float LODHYSTERESIS = 0.75f;
 		class Camera {
 		private:
 			float pitch_{ 0 };
@@ -112,26 +203,60 @@ namespace nr {
 				yaw_ -= 20;
 				UpdateRotation();
 			}
+			inline void SetPose(const glm::vec3& position, const float& yaw, const float& pitch) {
+				cameraPosition_ = position;
+				yaw_ = yaw;
+				pitch_ = pitch;
+				UpdateRotation();
+			}
 			inline glm::vec3 Position() const noexcept { return cameraPosition_; }
+			inline float Yaw() const noexcept { return yaw_; }
+			inline float Pitch() const noexcept { return pitch_; }
 			inline glm::vec3 Up() const noexcept { return cameraUp_; }
 			inline glm::vec3 Front() const noexcept { return cameraFront_; }
 		};
 		class Shader {
 		private:
 			std::string shaderName_;
-			std::string shaderSource_;
-			GLuint shaderID_;
+			std::string shaderFile_;
+			// only held until gl has its own copy, see Compile().
+			std::shared_ptr<const nr::assets::Asset> source_;
+			std::future<std::shared_ptr<const nr::assets::Asset>> pendingSource_;
+			GLenum shaderType_;
+			GLuint shaderID_{ 0 };
 		public:
-			Shader(const int& shaderType_, const std::string& shaderName, const std::string& shaderSourceFile)
+			// queues the read on workers_ and returns. a program cache hit never needs the shader compiled.
+			Shader(const int& shaderType, const std::string& shaderName, const std::string& shaderSourceFile)
 				:
 				shaderName_(shaderName),
-				shaderSource_(nr::util::ReadFile(shaderSourceFile)) {
+				shaderFile_(shaderSourceFile),
+				shaderType_(shaderType) {
+				const std::string fileName = shaderFile_;
+				pendingSource_ = workers_.Submit([fileName]() { return assets_.Load(fileName); });
+			}
+			// rereads the file. the next Compile() builds a new shader object from it.
+			void Reload() {
+				Destroy();
+				Release();
+				const std::string fileName = shaderFile_;
+				assets_.Forget(fileName);
+				pendingSource_ = workers_.Submit([fileName]() { return assets_.Load(fileName); });
+			}
+			// issues the compile without waiting for it.
+			void Compile() {
+				if (shaderID_) return;
 				shaderID_ = glCreateShader(shaderType_);
-				auto str = shaderSource_.data();
-				glShaderSource(shaderID_, 1, &str, NULL);
+				const std::string_view source = Source();
+				const GLchar* str = source.data();
+				const GLint length = source.size();
+				glShaderSource(shaderID_, 1, &str, &length);
 				glCompileShader(shaderID_);
+				// glShaderSource copies, the mapping is not needed any more.
+				Release();
 			}
+			// waits for the compile to finish.
 			bool CheckShader() {
+				Compile();
 				int success;
 				char infoLog[512];
 				glGetShaderiv(shaderID_, GL_COMPILE_STATUS, &success);
@@ -144,66 +269,278 @@ namespace nr {
 				return true;
 			}
 			void Destroy() {
-				// dealloc
+				if (shaderID_) glDeleteShader(shaderID_);
+				shaderID_ = 0;
 			}
 			inline GLuint ID() const noexcept { return shaderID_; }
+			inline GLenum Type() const noexcept { return shaderType_; }
+			inline const std::string& File() const noexcept { return shaderFile_; }
+			// blocks until the worker has mapped the file. maps it again if it was released.
+			std::string_view Source() {
+				if (pendingSource_.valid()) source_ = pendingSource_.get();
+				if (!source_) source_ = assets_.Load(shaderFile_);
+				return source_ ? source_->Text() : std::string_view();
+			}
+			inline void Release() noexcept {
+				source_.reset();
+			}
 			~Shader() {
 				Destroy();
 			}
 		};
 
+		// belongs to the simulation. window callbacks reach it through input_.
 		auto camera_ = std::make_unique<nr::driver::Camera>();
+		struct InputEvent {
+			enum class TYPE {
+				KEY,
+				CURSOR
+			};
+			TYPE type_;
+			int key_;
+			glm::vec2 cursor_;
+		};
+		// from the window callbacks to the simulation.
+		nr::driver::InputQueue<InputEvent, 256> input_;
 
+		// index into a program's uniform table, resolved once after Run().
+		struct UniformHandle {
+			int index_{ -1 };
+			inline bool Valid() const noexcept { return index_ >= 0; }
+		};
+		struct UniformStats {
+			unsigned int uploads_{ 0 };
+			unsigned int elided_{ 0 };
+			UniformStats& operator+=(const UniformStats& other) {
+				uploads_ += other.uploads_;
+				elided_ += other.elided_;
+				return *this;
+			}
+		};
+		enum class PROGRAMSTATUS {
+			PENDING,
+			READY,
+			FAILED
+		};
 		class Program {
+		public:
+			using handle_type = UniformHandle;
 		private:
+			struct Uniform {
+				std::uint32_t nameHash_;
+				GLint location_;
+				GLenum type_;
+				// last value uploaded, so repeated sets can be skipped.
+				bool cached_{ false };
+				std::array<float, 16> value_;
+			};
 			std::vector<std::unique_ptr<nr::driver::Shader>> shaders_;
-			GLuint programID_;
-			inline GLuint GetLocation(const std::string& uniformName) const {
-				return glGetUniformLocation(programID_, uniformName.data());
+			std::vector<Uniform> uniforms_;
+			UniformStats stats_;
+			// the program drawn with, and the one being linked to replace it.
+			GLuint programID_{ 0 };
+			GLuint pendingID_{ 0 };
+			// describes programID_. a relink in progress does not change it.
+			PROGRAMSTATUS status_{ PROGRAMSTATUS::PENDING };
+			std::uint64_t cacheKey_{ 0 };
+			// applied whenever a link completes.
+			std::vector<std::pair<std::string, GLuint>> blocks_;
+
+			void Reflect() {
+				GLint uniformCount = 0;
+				glGetProgramiv(programID_, GL_ACTIVE_UNIFORMS, &uniformCount);
+				for (auto& uniform : uniforms_) {
+					uniform.location_ = -1;
+					uniform.cached_ = false;
+				}
+				for (GLint i = 0; i < uniformCount; ++i) {
+					char name[256];
+					GLint size;
+					GLenum type;
+					glGetActiveUniform(programID_, i, sizeof(name), NULL, &size, &type, name);
+					GLint location = glGetUniformLocation(programID_, name);
+					// block members have no location.
+					if (location < 0) continue;
+					// arrays are reported as "name[0]".
+					if (char* bracket = std::strchr(name, '[')) *bracket = '\0';
+					const std::uint32_t nameHash = nr::util::Hash(name);
+					// existing entries keep their index so handles stay valid across relinks.
+					auto found = std::find_if(uniforms_.begin(), uniforms_.end(), [nameHash](const Uniform& uniform) {
+						return uniform.nameHash_ == nameHash;
+						});
+					if (found == uniforms_.end()) uniforms_.push_back({ nameHash, location, type, false, {} });
+					else {
+						found->location_ = location;
+						found->type_ = type;
+					}
+				}
+			}
+			template<typename T>
+			bool Changed(const UniformHandle& handle, const T& value) {
+				static_assert(sizeof(T) <= sizeof(Uniform::value_), "uniform value too large to cache");
+				if (!handle.Valid()) return false;
+				Uniform& uniform = uniforms_[handle.index_];
+				if (uniform.location_ < 0) return false;
+				if (uniform.cached_ && std::memcmp(uniform.value_.data(), &value, sizeof(T)) == 0) {
+					++stats_.elided_;
+					return false;
+				}
+				std::memcpy(uniform.value_.data(), &value, sizeof(T));
+				uniform.cached_ = true;
+				++stats_.uploads_;
+				return true;
+			}
+			// swaps the pending program in on success. a failed relink keeps the previous program.
+			void Complete(const bool& success) {
+				std::for_each(shaders_.begin(), shaders_.end(), [](std::unique_ptr<Shader>& shader) {
+					shader->Destroy();
+					// a cache hit hashed the source without ever compiling it.
+					shader->Release();
+					});
+				if (!success) {
+					glDeleteProgram(pendingID_);
+					pendingID_ = 0;
+					if (programID_) std::cout << "relink failed, keeping the previous program" << std::endl;
+					else status_ = PROGRAMSTATUS::FAILED;
+					return;
+				}
+				if (programID_) glDeleteProgram(programID_);
+				programID_ = pendingID_;
+				pendingID_ = 0;
+				status_ = PROGRAMSTATUS::READY;
+				Reflect();
+				for (const auto& block : blocks_) ApplyBlock(block.first.c_str(), block.second);
+			}
+			void ApplyBlock(const char* blockName, const GLuint& binding) {
+				GLuint blockIndex = glGetUniformBlockIndex(programID_, blockName);
+				if (blockIndex != GL_INVALID_INDEX) glUniformBlockBinding(programID_, blockIndex, binding);
+			}
+			inline GLint Location(const UniformHandle& handle) const {
+				return uniforms_[handle.index_].location_;
 			}
 		public:
 			void RegisterShader(std::unique_ptr<Shader>&& shader) {
+				if (hotReload_) shaderWatcher_.Watch(shader->File());
 				shaders_.push_back(std::move(shader));
 			}
-			bool Run() {
+			// issues everything for this program and returns without waiting on the driver.
+			// begin every program before finishing any, so their compiles overlap.
+			// while a program is ready it keeps drawing with the old binary until the new one links.
+			void Begin() {
+				if (pendingID_) glDeleteProgram(pendingID_);
+				pendingID_ = glCreateProgram();
+				cacheKey_ = programCache_.DriverKey();
 				for (const auto& shader : shaders_) {
-					if (!shader->CheckShader()) return false;
+					const GLenum type = shader->Type();
+					cacheKey_ = ProgramCache::Hash(&type, sizeof(type), cacheKey_);
+					cacheKey_ = ProgramCache::Hash(shader->Source(), cacheKey_);
+				}
+				if (programCache_.Load(cacheKey_, pendingID_)) {
+					Complete(true);
+					return;
 				}
-				programID_ = glCreateProgram();
+				for (const auto& shader : shaders_) shader->Compile();
 				std::for_each(shaders_.begin(), shaders_.end(), [this](const std::unique_ptr<Shader>& shader) {
-					glAttachShader(programID_, shader->ID());
+					glAttachShader(pendingID_, shader->ID());
 					});
-				glLinkProgram(programID_);
-				int success;
+				if (programCache_.Enabled()) glProgramParameteri(pendingID_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+				glLinkProgram(pendingID_);
+			}
+			// never blocks when the driver has KHR_parallel_shader_compile, otherwise same as Finish().
+			PROGRAMSTATUS Poll() {
+				if (!pendingID_) return status_;
+				if (GLAD_GL_KHR_parallel_shader_compile) {
+					GLint done = GL_FALSE;
+					glGetProgramiv(pendingID_, GL_COMPLETION_STATUS_KHR, &done);
+					if (!done) return status_;
+				}
+				return Finish();
+			}
+			// waits for the link.
+			PROGRAMSTATUS Finish() {
+				if (!pendingID_) return status_;
+				bool success = true;
+				for (const auto& shader : shaders_) success = shader->CheckShader() && success;
+				int linked = GL_FALSE;
 				char infoLog[512];
-				glGetProgramiv(programID_, GL_LINK_STATUS, &success);
-				if (!success) {
-					glGetProgramInfoLog(programID_, 512, NULL, infoLog);
+				glGetProgramiv(pendingID_, GL_LINK_STATUS, &linked);
+				if (success && !linked) {
+					glGetProgramInfoLog(pendingID_, 512, NULL, infoLog);
 					std::cout << infoLog << std::endl;
 				}
-				std::for_each(shaders_.begin(), shaders_.end(), [](std::unique_ptr<Shader>& shader) {
-					glDeleteShader(shader->ID());
-					});
-				return success;
+				if (success && linked) programCache_.Store(cacheKey_, pendingID_);
+				Complete(success && linked);
+				return status_;
+			}
+			bool Run() {
+				Begin();
+				return Finish() == PROGRAMSTATUS::READY;
+			}
+			// rereads and relinks if any of changedFiles belongs to this program. returns whether it did.
+			bool Reload(const std::vector<std::string>& changedFiles) {
+				bool affected = false;
+				for (const auto& shader : shaders_) {
+					if (std::find(changedFiles.begin(), changedFiles.end(), shader->File()) == changedFiles.end()) continue;
+					shader->Reload();
+					affected = true;
+				}
+				if (!affected) return false;
+				// shaders that did not change still need compiling, the old objects went with the last link.
+				Begin();
+				return true;
 			}
+			inline bool Ready() const noexcept { return status_ == PROGRAMSTATUS::READY; }
+			inline GLuint ID() const noexcept { return programID_; }
 			void Use() {
-				glUseProgram(programID_);
+				glState_.UseProgram(programID_);
+			}
+			// glsl 330 has no layout(binding), so blocks are pointed at their binding here.
+			// remembered, and applied again by every link that completes later.
+			void BindBlock(const char* blockName, const GLuint& binding) {
+				blocks_.push_back({ blockName, binding });
+				if (Ready()) ApplyBlock(blockName, binding);
+			}
+			// names not linked yet get a placeholder entry that Reflect() fills in, so handles
+			// can be resolved before the program is ready, or before a reload adds the uniform.
+			UniformHandle Handle(const std::uint32_t& nameHash) {
+				auto found = std::find_if(uniforms_.begin(), uniforms_.end(), [nameHash](const Uniform& uniform) {
+					return uniform.nameHash_ == nameHash;
+					});
+				if (found != uniforms_.end()) return { static_cast<int>(found - uniforms_.begin()) };
+				uniforms_.push_back({ nameHash, -1, 0, false, {} });
+				return { static_cast<int>(uniforms_.size() - 1) };
+			}
+			inline UniformHandle Handle(const char* uniformName) {
+				return Handle(nr::util::Hash(uniformName));
+			}
+			inline const UniformStats& Stats() const noexcept { return stats_; }
+			inline void ResetStats() noexcept { stats_ = {}; }
+
+			// setters apply to the program last Use()'d, same as glUniform*.
+			void SetUniformVec3(const UniformHandle& handle, const glm::vec3& vec) {
+				if (Changed(handle, vec)) glUniform3f(Location(handle), vec.x, vec.y, vec.z);
+			}
+			void SetUniformMat4(const UniformHandle& handle, const glm::mat4& mat) {
+				if (Changed(handle, mat)) glUniformMatrix4fv(Location(handle), 1, GL_FALSE, glm::value_ptr(mat));
+			}
+			void SetUniformInt(const UniformHandle& handle, const int& val) {
+				if (Changed(handle, val)) glUniform1i(Location(handle), val);
 			}
-			void SetUniformVec3(const std::string& uniformName, const glm::vec3& vec) {
-				GLuint uniformLoc = GetLocation(uniformName);
-				glUniform3f(uniformLoc, vec.x, vec.y, vec.z);
+			void SetUniformFloat(const UniformHandle& handle, const float& val) {
+				if (Changed(handle, val)) glUniform1f(Location(handle), val);
 			}
-			void SetUniformMat4(const std::string& uniformName, const glm::mat4& mat) {
-				GLuint uniformLoc = GetLocation(uniformName);
-				glUniformMatrix4fv(uniformLoc, 1, GL_FALSE, glm::value_ptr(mat));
+			// name based setters, for one-off uploads outside the frame loop.
+			void SetUniformVec3(const char* uniformName, const glm::vec3& vec) {
+				SetUniformVec3(Handle(uniformName), vec);
 			}
-			void SetUniformInt(const std::string& uniformName, const int& val) {
-				GLuint uniformLoc = GetLocation(uniformName);
-				glUniform1i(uniformLoc, val);
+			void SetUniformMat4(const char* uniformName, const glm::mat4& mat) {
+				SetUniformMat4(Handle(uniformName), mat);
 			}
-			void SetUniformFloat(const std::string& uniformName, const float& val) {
-				GLuint uniformLoc = GetLocation(uniformName);
-				glUniform1f(uniformLoc, val);
+			void SetUniformInt(const char* uniformName, const int& val) {
+				SetUniformInt(Handle(uniformName), val);
+			}
+			void SetUniformFloat(const char* uniformName, const float& val) {
+				SetUniformFloat(Handle(uniformName), val);
 			}
 		};
 	}
@@ -215,9 +552,7 @@ namespace nr {
 			case GLFW_KEY_SPACE: {
 				if (glfwGetKey(window, GLFW_KEY_SPACE) != GLFW_PRESS) break;
 				nr::driver::wireframeMode_ = !nr::driver::wireframeMode_;
-				if (nr::driver::wireframeMode_)
-					glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-				else glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+				nr::driver::glState_.PolygonMode(nr::driver::wireframeMode_ ? GL_LINE : GL_FILL);
 				break;
 			}
 			case GLFW_KEY_ESCAPE:{
@@ -226,32 +561,21 @@ namespace nr {
 
 				break;
 			}
-			case GLFW_KEY_S:{
-				nr::driver::camera_->MoveSouth();
-				break;
-			}
-			case GLFW_KEY_W:{
-				nr::driver::camera_->MoveNorth();
-				break;
-			}
-			case GLFW_KEY_A:{
-				nr::driver::camera_->MoveEast();
-				break;
-			}
-			case GLFW_KEY_D:{
-				nr::driver::camera_->MoveWest();
-				break;
-			}
+			// camera keys are the simulation's business.
+			case GLFW_KEY_S:
+			case GLFW_KEY_W:
+			case GLFW_KEY_A:
+			case GLFW_KEY_D:
 			case GLFW_KEY_RIGHT:
 			{
-				nr::driver::camera_->LookRight();
+				nr::driver::input_.Push({ nr::driver::InputEvent::TYPE::KEY, key, {} });
 				break;
 			}
 			}
 		}
 		void CursorPosCallback(GLFWwindow* window, double xPos, double yPos) {
 			if (!nr::driver::mouseActive_) return;
-			nr::driver::camera_->UpdateMousePosition({ xPos, yPos });
+			nr::driver::input_.Push({ nr::driver::InputEvent::TYPE::CURSOR, 0, glm::vec2(xPos, yPos) });
 		}
 	}
 }
@@ -259,6 +583,16 @@ namespace nr {
 	namespace driver {
 		std::unique_ptr<nr::driver::Program> geometryProgram_;
 		std::unique_ptr<nr::driver::Program> lightingProgram_;
+		// flat shaded, drawn in place of any program still linking.
+		std::unique_ptr<nr::driver::Program> fallbackProgram_;
+		// the deferred path's, only created when it is on. emissiveGBufferProgram_ stands in for lightingProgram_.
+		std::unique_ptr<nr::driver::Program> gBufferProgram_;
+		std::unique_ptr<nr::driver::Program> emissiveGBufferProgram_;
+		std::unique_ptr<nr::driver::Program> deferredAmbientProgram_;
+		std::unique_ptr<nr::driver::Program> lightVolumeProgram_;
+		// only created when depthPrePass_ and overdrawView_ are on.
+		std::unique_ptr<nr::driver::Program> depthProgram_;
+		std::unique_ptr<nr::driver::Program> overdrawProgram_;
 
 		glm::mat4 projectionMatrix_;
 		GLuint VAO_;
@@ -266,6 +600,133 @@ namespace nr {
 		GLuint VBO_;
 		GLuint EBO_;
 		unsigned int INDEXCOUNT;
+		GLenum INDEXTYPE;
+		nr::geometry::StaticBatch<nr::geometry::WorldCube::vertex_type> staticBatch_;
+		nr::geometry::AABB sceneBounds_;
+		nr::culling::BVH sceneBVH_;
+		nr::culling::Frustum frustum_;
+		std::vector<unsigned int> visibleShapes_;
+		GLuint instanceVAO_;
+		GLuint cubeVBO_;
+		GLuint cubeEBO_;
+		GLuint instanceVBO_;
+		// one instance with no offset, unit scale and white, for vaos that draw a single mesh.
+		GLuint defaultInstanceVBO_;
+		unsigned int CUBEINDEXCOUNT;
+		unsigned int INSTANCECOUNT = 0;
+		nr::geometry::AABB instanceBounds_;
+		// resting positions of the animated instances, and where each frame's copy is written.
+		std::vector<nr::geometry::Instance> baseInstances_;
+		nr::driver::StreamBuffer instanceStream_;
+		nr::driver::UniformBuffer<nr::driver::FrameBlock> frameUniforms_;
+		nr::driver::CameraPath cameraPath_;
+		nr::benchmark::FrameTimer frameTimer_;
+		nr::benchmark::FragmentCounter fragmentCounter_;
+		nr::culling::OcclusionBuffer occlusionBuffer_;
+		// boxes that could occlude this frame, with how big each looks from the camera.
+		std::vector<std::pair<float, nr::geometry::AABB>> occluderCandidates_;
+		nr::driver::RenderQueue<Program> renderQueue_;
+		unsigned int sceneMaterial_;
+		unsigned int whiteMaterial_;
+		// lit props use the geometry program, the rest the light's.
+		struct Prop {
+			bool lit_;
+			GLuint VAO_;
+			DrawCommand command_;
+			unsigned int material_;
+			glm::mat4 model_;
+			glm::vec3 position_;
+		};
+		std::vector<Prop> props_;
+		nr::lighting::ClusterGrid clusterGrid_;
+		nr::lighting::ClusterBuffers clusterBuffers_;
+		// where each point light circles around.
+		std::vector<nr::lighting::PointLight> pointLightOrigins_;
+		nr::lighting::GBuffer gBuffer_;
+		// attributeless, for the full screen pass.
+		GLuint fullscreenVAO_;
+		GLuint volumeVAO_;
+		GLuint volumeVBO_;
+		GLuint volumeEBO_;
+		unsigned int VOLUMEINDEXCOUNT;
+		// each frame's point lights, read as volume instances.
+		nr::driver::StreamBuffer volumeStream_;
+		// one unit sphere for every lod prop, its levels all in one element buffer.
+		GLuint sphereVAO_;
+		GLuint sphereVBO_;
+		GLuint sphereEBO_;
+		nr::geometry::LODChain sphereLOD_;
+		struct LODProp {
+			glm::vec3 position_;
+			float radius_;
+			unsigned int material_;
+		};
+		std::vector<LODProp> lodSpheres_;
+		// per frame. fullTriangles_ is what the same spheres cost at full detail.
+		struct LODStats {
+			std::size_t triangles_{ 0 };
+			std::size_t fullTriangles_{ 0 };
+			unsigned int simplified_{ 0 };
+		};
+
+		// everything Render needs from the simulation for one frame, produced whole and never changed after.
+		struct FrameSnapshot {
+			nr::driver::FrameBlock block_;
+			glm::vec3 lightPosition_;
+			// this tick's animated instances, empty when they are static.
+			std::vector<nr::geometry::Instance> instances_;
+			// the visible part of the static batch, as ranges for one glMultiDrawElements.
+			std::vector<GLsizei> drawCounts_;
+			std::vector<const void*> drawOffsets_;
+			nr::culling::CullStats cullStats_;
+			nr::culling::OcclusionStats occlusionStats_;
+			nr::lighting::ClusterLists clusters_;
+			// the level each lod sphere is drawn at.
+			std::vector<unsigned int> sphereLevels_;
+			LODStats lodStats_;
+			unsigned int tick_{ 0 };
+		};
+		nr::driver::SnapshotBuffer<FrameSnapshot> snapshots_;
+		// simulation state, only touched by whichever thread runs the ticks.
+		nr::lighting::LightSource lightSource_{ glm::vec3(0.0f), glm::vec3(1.0f) };
+		std::vector<nr::lighting::PointLight> pointLights_;
+		// kept from tick to tick, it is what the hysteresis is measured from.
+		std::vector<unsigned int> sphereLevels_;
+		unsigned int tick_ = 0;
+		// points the bound vao's per-instance attributes at instances starting offset bytes into buffer.
+		void BindInstanceAttributes(const GLuint& buffer, const GLintptr& offset) {
+			glState_.BindBuffer(GL_ARRAY_BUFFER, buffer);
+			glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCE), 4, GL_FLOAT, GL_FALSE, sizeof(nr::geometry::Instance), (void*)(offset + offsetof(nr::geometry::Instance, transform_)));
+			glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCECOLOR), 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(nr::geometry::Instance), (void*)(offset + offsetof(nr::geometry::Instance, color_)));
+		}
+		// the bound vao's instance attributes read defaultInstanceVBO_. gl leaves the generic values glVertexAttrib
+		// sets undefined once a draw has read that attribute from an array, so they are no substitute.
+		void BindDefaultInstance() {
+			BindInstanceAttributes(defaultInstanceVBO_, 0);
+			glVertexAttribDivisor(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCE), 1);
+			glVertexAttribDivisor(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCECOLOR), 1);
+			glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCE));
+			glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCECOLOR));
+		}
+		// the deferred path's programs, empty when it is off.
+		std::vector<Program*> DeferredPrograms() {
+			if (!deferredShading_) return {};
+			return { gBufferProgram_.get(), emissiveGBufferProgram_.get(), deferredAmbientProgram_.get(), lightVolumeProgram_.get() };
+		}
+		// every program beyond the three always there, for whatever is done to all of them.
+		std::vector<Program*> OptionalPrograms() {
+			std::vector<Program*> programs = DeferredPrograms();
+			for (auto program : { depthProgram_.get(), overdrawProgram_.get() }) {
+				if (program) programs.push_back(program);
+			}
+			return programs;
+		}
+		// points the bound vao's per-instance attributes at point lights packed as ClusterLists::lights_ packs them.
+		void BindLightAttributes(const GLuint& buffer, const GLintptr& offset) {
+			glState_.BindBuffer(GL_ARRAY_BUFFER, buffer);
+			glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCE), 4, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec4), (void*)offset);
+			glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCECOLOR), 4, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec4), (void*)(offset + sizeof(glm::vec4)));
+		}
 		namespace init {
 			inline bool InitContext() {
 				glfwMakeContextCurrent(nr::driver::window_);
@@ -275,6 +736,8 @@ namespace nr {
 				glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 				glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 				glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+				// the g-buffer, cluster grid and projection are sized for the framebuffer once, at init.
+				glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 				nr::driver::window_ = glfwCreateWindow(width, height, title, NULL, NULL);
 				return nr::driver::window_;
 			}
@@ -282,53 +745,218 @@ namespace nr {
 				glfwSetKeyCallback(nr::driver::window_, &nr::callbacks::KeyCallback);
 				glfwSetCursorPosCallback(nr::driver::window_, nr::callbacks::CursorPosCallback);
 			}
-			void InitShapes(std::vector<float>& vertices, std::vector<unsigned int>& indices) {
-				std::array<nr::geometry::Cube, 1> cubes = {
-				nr::geometry::Cube (glm::vec3(0.0f, 0.0f, 0.0f), 1.0f),
-				};
-				for (int i = 0; i < cubes.size(); ++i) {
-					nr::geometry::Cube& cube{ cubes.at(i) };
-					vertices.insert(vertices.end(), cube.vertices.begin(), cube.vertices.end());
-					std::transform(cube.indices.begin(), cube.indices.end(), std::back_inserter(indices), [i](unsigned int index) mutable{
-						return index + (i * nr::geometry::Cube::VertexCount());
-					});
+			void InitShapes(nr::geometry::StaticBatch<nr::geometry::WorldCube::vertex_type>& batch) {
+				const float spacing{ 3.0f };
+				std::vector<nr::geometry::AABB> bounds;
+				for (unsigned int y = 0; y < sceneGrid_.y; ++y) {
+					for (unsigned int z = 0; z < sceneGrid_.z; ++z) {
+						for (unsigned int x = 0; x < sceneGrid_.x; ++x) {
+							nr::geometry::WorldCube cube(glm::vec3(x * spacing, y * spacing, z * spacing), 1.0f);
+							bounds.push_back(cube.Bounds());
+							sceneBounds_.Grow(bounds.back());
+							batch.Add(cube);
+						}
+					}
 				}
-				nr::driver::INDEXCOUNT = indices.size();
-				// specify a normal for a face.
-					//
+				batch.Build();
+				// submesh ids match the order shapes were added, so bounds[i] belongs to submesh i.
+				sceneBVH_.Build(bounds);
+				nr::driver::INDEXCOUNT = batch.IndexCount();
+				nr::driver::INDEXTYPE = batch.IndexType();
 			}
-			void InitArrays() {
-				std::vector<float> vertices;
-				std::vector<unsigned int> indices;
+			void InitInstances(std::vector<nr::geometry::Instance>& instances) {
+				if (!stressMode_) return;
+				const float spacing = stressSpacing_;
+				instances.reserve(stressGrid_.x * stressGrid_.y * stressGrid_.z);
+				for (unsigned int y = 0; y < stressGrid_.y; ++y) {
+					for (unsigned int z = 0; z < stressGrid_.z; ++z) {
+						for (unsigned int x = 0; x < stressGrid_.x; ++x) {
+							glm::vec3 color(x / float(stressGrid_.x), y / float(stressGrid_.y), z / float(stressGrid_.z));
+							instances.push_back({ glm::vec4(x * spacing, y * spacing, z * spacing, 1.0f), nr::vertex::PackColor(color) });
+							instanceBounds_.Grow(glm::vec3(instances.back().transform_));
+						}
+					}
+				}
+				nr::driver::INSTANCECOUNT = instances.size();
+			}
+			void InitInstanceArrays() {
+				std::vector<nr::geometry::Instance> instances;
+				InitInstances(instances);
+
+				// a single unit cube, every instance reuses it.
+				nr::geometry::Cube cube(glm::vec3(-0.5f), 1.0f);
+				nr::driver::CUBEINDEXCOUNT = cube.indices.size();
+
+				glGenVertexArrays(1, &instanceVAO_);
+				glState_.BindVertexArray(instanceVAO_);
+
+				glGenBuffers(1, &cubeVBO_);
+				glGenBuffers(1, &cubeEBO_);
+				glGenBuffers(1, &instanceVBO_);
+
+				glState_.BindBuffer(GL_ARRAY_BUFFER, cubeVBO_);
+				glBufferData(GL_ARRAY_BUFFER, sizeof(nr::geometry::Cube::vertex_type) * cube.vertices.size(), cube.vertices.data(), GL_STATIC_DRAW);
+				nr::vertex::BindLayout<nr::geometry::Cube::vertex_type>();
+
+				glState_.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO_);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, cube.indices.size() * sizeof(unsigned int), cube.indices.data(), GL_STATIC_DRAW);
 
-				InitShapes(vertices, indices);
+				// per-instance attributes advance once per instance rather than per vertex.
+				// animated instances are re-pointed into the stream every frame, see StreamInstances.
+				if ((animateInstances_ || sortInstances_ || occlusionCulling_) && !instances.empty()) {
+					instanceStream_.Init(GL_ARRAY_BUFFER, sizeof(nr::geometry::Instance) * instances.size(), 4);
+					baseInstances_ = std::move(instances);
+					BindInstanceAttributes(instanceStream_.ID(), 0);
+				}
+				else {
+					glState_.BindBuffer(GL_ARRAY_BUFFER, instanceVBO_);
+					glBufferData(GL_ARRAY_BUFFER, sizeof(nr::geometry::Instance) * instances.size(), instances.data(), GL_STATIC_DRAW);
+					BindInstanceAttributes(instanceVBO_, 0);
+				}
+				glVertexAttribDivisor(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCE), 1);
+				glVertexAttribDivisor(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCECOLOR), 1);
+				glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCE));
+				glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCECOLOR));
+
+				const nr::geometry::Instance identity = { glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), nr::vertex::PackColor(glm::vec3(1.0f)) };
+				glGenBuffers(1, &defaultInstanceVBO_);
+				glState_.BindBuffer(GL_ARRAY_BUFFER, defaultInstanceVBO_);
+				glBufferData(GL_ARRAY_BUFFER, sizeof(identity), &identity, GL_STATIC_DRAW);
+			}
+			void InitArrays() {
+				InitShapes(staticBatch_);
 				glGenVertexArrays(1, &VAO_);
-				glBindVertexArray(VAO_);
+				glState_.BindVertexArray(VAO_);
 
 				glGenBuffers(1, &VBO_);
 				glGenBuffers(1, &EBO_);
 
-				glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-				glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), vertices.data(), GL_DYNAMIC_DRAW);
+				glState_.BindBuffer(GL_ARRAY_BUFFER, VBO_);
+				glBufferData(GL_ARRAY_BUFFER, sizeof(nr::geometry::WorldCube::vertex_type) * staticBatch_.Vertices().size(), staticBatch_.Vertices().data(), GL_STATIC_DRAW);
 
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
-				glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(float), indices.data(), GL_STATIC_DRAW);
+				glState_.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, staticBatch_.IndexCount() * staticBatch_.IndexSize(), staticBatch_.IndexData(), GL_STATIC_DRAW);
 
-				glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::POSITION), 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
-				//glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::COLOR), 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)(3 * sizeof(float)));
-				//glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::COLOR));
-				glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::POSITION));
+				nr::vertex::BindLayout<nr::geometry::WorldCube::vertex_type>();
 
+				InitInstanceArrays();
+				glState_.BindVertexArray(VAO_);
+				BindDefaultInstance();
 
-				// create a new VAO for the lighting, with the same VBO. same data, different interpretation.
+				// create a new VAO for the lighting, over the unit cube rather than the whole scene.
 				glGenVertexArrays(1, &lightVAO_);
-				glBindVertexArray(lightVAO_);
+				glState_.BindVertexArray(lightVAO_);
 
-				glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-				glVertexAttribPointer(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::POSITION), 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
-				glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::POSITION));
+				glState_.BindBuffer(GL_ARRAY_BUFFER, cubeVBO_);
+				nr::vertex::BindLayout<nr::geometry::Cube::vertex_type>();
+				glState_.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO_);
+				BindDefaultInstance();
+			}
+			void InitLightVolumes() {
+				glGenVertexArrays(1, &fullscreenVAO_);
 
+				const nr::geometry::Icosahedron volume(glm::vec3(0.0f), 1.0f);
+				nr::driver::VOLUMEINDEXCOUNT = volume.indices.size();
+				glGenVertexArrays(1, &volumeVAO_);
+				glState_.BindVertexArray(volumeVAO_);
+				glGenBuffers(1, &volumeVBO_);
+				glGenBuffers(1, &volumeEBO_);
+				glState_.BindBuffer(GL_ARRAY_BUFFER, volumeVBO_);
+				glBufferData(GL_ARRAY_BUFFER, sizeof(nr::geometry::Icosahedron::vertex_type) * volume.vertices.size(), volume.vertices.data(), GL_STATIC_DRAW);
+				nr::vertex::BindLayout<nr::geometry::Icosahedron::vertex_type>();
+				glState_.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, volumeEBO_);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, volume.indices.size() * sizeof(unsigned int), volume.indices.data(), GL_STATIC_DRAW);
 
+				if (pointLightCount_) {
+					const unsigned int lightCount = std::min(pointLightCount_, nr::lighting::ClusterGrid::MAXLIGHTS);
+					volumeStream_.Init(GL_ARRAY_BUFFER, 2 * sizeof(glm::vec4) * lightCount, sizeof(glm::vec4));
+					BindLightAttributes(volumeStream_.ID(), 0);
+				}
+				glVertexAttribDivisor(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCE), 1);
+				glVertexAttribDivisor(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCECOLOR), 1);
+				glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCE));
+				glEnableVertexAttribArray(static_cast<GLuint>(nr::driver::VERTEXATTRIBUTE::INSTANCECOLOR));
+			}
+			// dealt round the programs, vaos and materials in turn, so in the order they are added
+			// nearly every prop switches something.
+			void InitProps() {
+				sceneMaterial_ = renderQueue_.AddMaterial({ glm::vec3(0.2f, 0.7f, 0.0f), 0.7f });
+				whiteMaterial_ = renderQueue_.AddMaterial({ glm::vec3(1.0f), 0.7f });
+				const std::array<unsigned int, 4> palette = {
+					renderQueue_.AddMaterial({ glm::vec3(0.9f, 0.3f, 0.2f), 0.7f }),
+					renderQueue_.AddMaterial({ glm::vec3(0.2f, 0.4f, 0.9f), 0.7f }),
+					renderQueue_.AddMaterial({ glm::vec3(0.9f, 0.8f, 0.2f), 0.5f }),
+					renderQueue_.AddMaterial({ glm::vec3(0.6f, 0.2f, 0.8f), 0.5f })
+				};
+				// the batch's first cube spans 0 to 1, the light's unit cube is centred.
+				const nr::geometry::Submesh& submesh = staticBatch_.Submeshes().front();
+				const DrawCommand batchCube = DrawCommand::Elements(submesh.indexCount_, INDEXTYPE, (void*)(std::size_t(submesh.firstIndex_) * staticBatch_.IndexSize()));
+				const DrawCommand unitCube = DrawCommand::Elements(CUBEINDEXCOUNT, GL_UNSIGNED_INT);
+				props_.reserve(looseProps_);
+				for (unsigned int i = 0; i < looseProps_; ++i) {
+					// a sunflower spiral, evenly spread whatever the count.
+					const float angle = i * 2.39996f;
+					const float radius = 3.0f * std::sqrt(float(i));
+					const glm::vec3 position(radius * std::cos(angle), float(i % 5) * 2.0f - 4.0f, radius * std::sin(angle));
+					const bool batch = (i / 2) % 2;
+					const glm::vec3 corner = batch ? position - glm::vec3(0.5f) : position;
+					props_.push_back({ i % 2 == 0, batch ? VAO_ : lightVAO_, batch ? batchCube : unitCube, palette[i % palette.size()], glm::translate(glm::mat4(1.0f), corner), position });
+				}
+			}
+			// a sunflower spiral above the scene, so the camera sees spheres from a few units away to far across it.
+			void InitLODProps() {
+				if (!lodProps_) return;
+				const nr::geometry::Sphere sphere(glm::vec3(0.0f), 1.0f, 4);
+				sphereLOD_ = nr::geometry::BuildLODChain(sphere);
+				if (printStats_) {
+					std::cout << "lod chain:";
+					for (const nr::geometry::LODLevel& level : sphereLOD_.levels_) std::cout << " " << level.indexCount_ / 3;
+					std::cout << " triangles" << std::endl;
+				}
+
+				glGenVertexArrays(1, &sphereVAO_);
+				glState_.BindVertexArray(sphereVAO_);
+				glGenBuffers(1, &sphereVBO_);
+				glGenBuffers(1, &sphereEBO_);
+				glState_.BindBuffer(GL_ARRAY_BUFFER, sphereVBO_);
+				glBufferData(GL_ARRAY_BUFFER, sizeof(nr::geometry::Sphere::vertex_type) * sphere.vertices.size(), sphere.vertices.data(), GL_STATIC_DRAW);
+				nr::vertex::BindLayout<nr::geometry::Sphere::vertex_type>();
+				glState_.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO_);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereLOD_.indices_.size() * sizeof(unsigned int), sphereLOD_.indices_.data(), GL_STATIC_DRAW);
+				BindDefaultInstance();
+
+				const std::array<unsigned int, 3> palette = {
+					renderQueue_.AddMaterial({ glm::vec3(0.8f, 0.8f, 0.8f), 0.6f }),
+					renderQueue_.AddMaterial({ glm::vec3(0.3f, 0.8f, 0.7f), 0.6f }),
+					renderQueue_.AddMaterial({ glm::vec3(0.9f, 0.5f, 0.3f), 0.6f })
+				};
+				lodSpheres_.reserve(lodProps_);
+				for (unsigned int i = 0; i < lodProps_; ++i) {
+					const float angle = i * 2.39996f;
+					const float radius = 6.0f * std::sqrt(float(i));
+					lodSpheres_.push_back({ glm::vec3(radius * std::cos(angle), 8.0f, radius * std::sin(angle)), 1.5f, palette[i % palette.size()] });
+				}
+				// start at full detail, the first tick settles them.
+				sphereLevels_.assign(lodProps_, 0);
+			}
+			// spread evenly over everything drawn, with the r3 low discrepancy sequence.
+			void InitPointLights() {
+				nr::geometry::AABB bounds = sceneBounds_;
+				if (INSTANCECOUNT) bounds.Grow(instanceBounds_);
+				for (const Prop& prop : props_) bounds.Grow(prop.position_);
+				for (const LODProp& sphere : lodSpheres_) bounds.Grow(sphere.position_);
+				const glm::vec3 low = bounds.min_ - glm::vec3(5.0f);
+				const glm::vec3 size = bounds.max_ - bounds.min_ + glm::vec3(10.0f);
+				const glm::vec3 step(0.8191725f, 0.6710436f, 0.5497005f);
+				pointLightOrigins_.resize(pointLightCount_);
+				for (unsigned int i = 0; i < pointLightCount_; ++i) {
+					const glm::vec3 sample = glm::fract(glm::vec3(0.5f) + step * float(i + 1));
+					// a saturated hue, dimmed so that overlapping lights do not wash out.
+					const glm::vec3 hue = glm::fract(glm::vec3(0.0f, 1.0f / 3.0f, 2.0f / 3.0f) + sample.y);
+					const glm::vec3 color = glm::clamp(glm::abs(hue * 6.0f - glm::vec3(3.0f)) - glm::vec3(1.0f), 0.0f, 1.0f);
+					pointLightOrigins_[i] = { low + sample * size, 4.0f + 4.0f * sample.z, color * 0.5f };
+				}
+				pointLights_ = pointLightOrigins_;
 			}
 			void InitShaders() {
 				geometryProgram_ = std::make_unique<nr::driver::Program>();
@@ -339,71 +967,583 @@ namespace nr {
 				lightingProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_VERTEX_SHADER, "lightingVertexShader", "vertexShader.vert"));
 				lightingProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_FRAGMENT_SHADER, "fragmentShader", "lightSourceFragmentShader.frag"));
 
+				fallbackProgram_ = std::make_unique<nr::driver::Program>();
+				fallbackProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_VERTEX_SHADER, "fallbackVertexShader", "vertexShader.vert"));
+				fallbackProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_FRAGMENT_SHADER, "fallbackShader", "fallbackShader.frag"));
+
+				if (depthPrePass_) {
+					depthProgram_ = std::make_unique<nr::driver::Program>();
+					depthProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_VERTEX_SHADER, "depthVertexShader", "vertexShader.vert"));
+					depthProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_FRAGMENT_SHADER, "depthShader", "depth.frag"));
+				}
+				if (overdrawView_) {
+					overdrawProgram_ = std::make_unique<nr::driver::Program>();
+					overdrawProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_VERTEX_SHADER, "overdrawVertexShader", "vertexShader.vert"));
+					overdrawProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_FRAGMENT_SHADER, "overdrawShader", "overdraw.frag"));
+				}
 
+				if (!deferredShading_) return;
+				gBufferProgram_ = std::make_unique<nr::driver::Program>();
+				gBufferProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_VERTEX_SHADER, "gBufferVertexShader", "vertexShader.vert"));
+				gBufferProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_FRAGMENT_SHADER, "gBufferShader", "gbuffer.frag"));
 
+				emissiveGBufferProgram_ = std::make_unique<nr::driver::Program>();
+				emissiveGBufferProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_VERTEX_SHADER, "emissiveVertexShader", "vertexShader.vert"));
+				emissiveGBufferProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_FRAGMENT_SHADER, "emissiveShader", "gbuffer.frag"));
+
+				deferredAmbientProgram_ = std::make_unique<nr::driver::Program>();
+				deferredAmbientProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_VERTEX_SHADER, "fullscreenVertexShader", "fullscreen.vert"));
+				deferredAmbientProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_FRAGMENT_SHADER, "deferredAmbientShader", "deferredAmbient.frag"));
+
+				lightVolumeProgram_ = std::make_unique<nr::driver::Program>();
+				lightVolumeProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_VERTEX_SHADER, "lightVolumeVertexShader", "lightVolume.vert"));
+				lightVolumeProgram_->RegisterShader(std::make_unique<nr::driver::Shader>(GL_FRAGMENT_SHADER, "lightVolumeShader", "lightVolume.frag"));
+			}
+			void InitBenchmark() {
+				if (headless_) benchmark_ = true;
+				if (benchmark_) frameTimer_.Init();
+				if (countOverdraw_) fragmentCounter_.Init();
+				if (occlusionCulling_) occlusionBuffer_.Init(occlusionResolution_.x, occlusionResolution_.y);
+				if (recordCameraPath_) return;
+				if (!cameraPathFile_.empty() && !cameraPath_.Load(cameraPathFile_)) std::cout << "could not load camera path " << cameraPathFile_ << std::endl;
+				// headless runs need some motion to be meaningful.
+				if (cameraPath_.Empty() && headless_) cameraPath_ = nr::driver::CameraPath::Orbit(glm::vec3(0.0f), 20.0f, 5.0f, benchmarkFrames_);
 			}
 			bool InitProgram(const unsigned int& windowWidth, const unsigned int& windowHeight, const char* windowName) {
-				if (!glfwInit() || !InitWindow(windowWidth, windowHeight, windowName) || !InitContext()) return false;
-				InitCallbacks();
+				// benchmark frames should not pick up edits half way through.
+				if (headless_) hotReload_ = false;
+				if (headless_) {
+					if (!nr::headless::InitContext() || !nr::headless::InitFramebuffer(windowWidth, windowHeight)) return false;
+					defaultFramebuffer_ = nr::headless::framebuffer_;
+					framebufferSize_ = glm::uvec2(windowWidth, windowHeight);
+				}
+				else {
+					if (!glfwInit() || !InitWindow(windowWidth, windowHeight, windowName) || !InitContext()) return false;
+					InitCallbacks();
+					int width = 0;
+					int height = 0;
+					glfwGetFramebufferSize(window_, &width, &height);
+					framebufferSize_ = glm::uvec2(width, height);
+				}
 				InitArrays();
+				InitProps();
+				InitLODProps();
+				InitPointLights();
+				if (deferredShading_) InitLightVolumes();
 				InitShaders();
-				geometryProgram_->Run();
-				lightingProgram_->Run();
-				return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+				programCache_.Init(programCacheDirectory_);
+				if (GLAD_GL_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+				// every compile and link is in flight before any status is asked for.
+				fallbackProgram_->Begin();
+				geometryProgram_->Begin();
+				lightingProgram_->Begin();
+				for (auto program : OptionalPrograms()) program->Begin();
+				if (programCache_.Enabled()) std::cout << "program cache: " << programCache_.Hits() << " hits, " << programCache_.Misses() << " misses" << std::endl;
+				for (auto program : { fallbackProgram_.get(), geometryProgram_.get(), lightingProgram_.get() }) program->BindBlock("FrameBlock", FRAMEBLOCKBINDING);
+				for (auto program : OptionalPrograms()) program->BindBlock("FrameBlock", FRAMEBLOCKBINDING);
+				// only the fallback is needed for the first frame, the rest are picked up by Render as they finish.
+				// benchmarks wait for all of them so every frame measures the same thing.
+				if (fallbackProgram_->Finish() != PROGRAMSTATUS::READY) return false;
+				if (headless_ || benchmark_) {
+					geometryProgram_->Finish();
+					lightingProgram_->Finish();
+					for (auto program : OptionalPrograms()) program->Finish();
+				}
+				if (printStats_) std::cout << "assets: " << assets_.Loads() << " mapped, " << assets_.Reuses() << " shared, " << assets_.Resident() << " still resident" << std::endl;
+				frameUniforms_.Init(FRAMEBLOCKBINDING);
+				clusterBuffers_.Init();
+				clusterBuffers_.Bind(CLUSTERTEXTUREUNIT);
+				if (deferredShading_) {
+					if (!gBuffer_.Init(framebufferSize_.x, framebufferSize_.y)) return false;
+					gBuffer_.BindTextures(GBUFFERTEXTUREUNIT);
+					glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer_);
+				}
+				InitBenchmark();
+				return headless_ || gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+			}
+		}
+		// an instance's cube, its scale is the edge length.
+		inline nr::geometry::AABB InstanceBounds(const nr::geometry::Instance& instance) {
+			const glm::vec3 center(instance.transform_);
+			const glm::vec3 extent(0.5f * instance.transform_.w);
+			return { center - extent, center + extent };
+		}
+		// after frustum culling. every shape and instance is a cube, so the boxes that look biggest are rasterized
+		// as they are, and whatever is behind them is dropped from visibleShapes_ and the frame's instances.
+		void CullOccluded(const glm::mat4& viewProjection, FrameSnapshot& frame) {
+			if (!frame.instances_.empty()) {
+				frame.instances_.erase(std::remove_if(frame.instances_.begin(), frame.instances_.end(), [](const nr::geometry::Instance& instance) {
+					return frustum_.Test(InstanceBounds(instance)) == nr::culling::CULLRESULT::OUTSIDE;
+				}), frame.instances_.end());
+			}
+			const glm::vec3 eye = camera_->Position();
+			occluderCandidates_.clear();
+			auto consider = [&eye](const nr::geometry::AABB& box) {
+				const glm::vec3 extent = box.Extent();
+				const glm::vec3 offset = box.Center() - eye;
+				occluderCandidates_.push_back({ glm::dot(extent, extent) / std::max(glm::dot(offset, offset), 1e-6f), box });
+			};
+			for (const unsigned int& shape : visibleShapes_) consider(sceneBVH_.Bounds(shape));
+			for (const nr::geometry::Instance& instance : frame.instances_) consider(InstanceBounds(instance));
+			const std::size_t occluderCount = std::min<std::size_t>(occluderCount_, occluderCandidates_.size());
+			std::nth_element(occluderCandidates_.begin(), occluderCandidates_.begin() + occluderCount, occluderCandidates_.end(), [](const auto& a, const auto& b) {
+				return a.first > b.first;
+			});
+
+			occlusionBuffer_.Begin(viewProjection);
+			for (std::size_t i = 0; i < occluderCount; ++i) occlusionBuffer_.AddBox(occluderCandidates_[i].second);
+			occlusionBuffer_.Rasterize(workers_);
+			occlusionBuffer_.Cull(visibleShapes_, [](const unsigned int& shape) { return sceneBVH_.Bounds(shape); });
+			occlusionBuffer_.Cull(frame.instances_, InstanceBounds);
+			frame.occlusionStats_ = occlusionBuffer_.Stats();
+		}
+		// the batch submeshes inside the frustum, merging neighbouring ranges into one draw. reads only
+		// data fixed at init, so it runs on the simulation side.
+		void CullVisibleShapes(const glm::mat4& viewProjection, FrameSnapshot& frame) {
+			std::vector<GLsizei>& drawCounts_ = frame.drawCounts_;
+			std::vector<const void*>& drawOffsets_ = frame.drawOffsets_;
+			drawCounts_.clear();
+			drawOffsets_.clear();
+			frame.cullStats_ = {};
+			frustum_.Extract(viewProjection);
+			visibleShapes_.clear();
+			sceneBVH_.Cull(frustum_, visibleShapes_, frame.cullStats_);
+			if (occlusionCulling_) CullOccluded(viewProjection, frame);
+			if (visibleShapes_.empty()) return;
+			std::sort(visibleShapes_.begin(), visibleShapes_.end());
+
+			const auto& submeshes = staticBatch_.Submeshes();
+			const unsigned int indexSize = staticBatch_.IndexSize();
+			unsigned int rangeStart = submeshes[visibleShapes_.front()].firstIndex_;
+			unsigned int rangeEnd = rangeStart;
+			for (const unsigned int& shape : visibleShapes_) {
+				const nr::geometry::Submesh& submesh = submeshes[shape];
+				if (submesh.firstIndex_ != rangeEnd) {
+					drawCounts_.push_back(rangeEnd - rangeStart);
+					drawOffsets_.push_back((void*)(std::size_t(rangeStart) * indexSize));
+					rangeStart = submesh.firstIndex_;
+				}
+				rangeEnd = submesh.firstIndex_ + submesh.indexCount_;
+			}
+			drawCounts_.push_back(rangeEnd - rangeStart);
+			drawOffsets_.push_back((void*)(std::size_t(rangeStart) * indexSize));
+		}
+		// starts relinking every program using a shader that changed on disk. Render swaps them in as they finish.
+		void ReloadChangedPrograms() {
+			const std::vector<std::string> changed = shaderWatcher_.Changed();
+			if (changed.empty()) return;
+			for (const std::string& fileName : changed) std::cout << "reloading " << fileName << std::endl;
+			for (auto program : { geometryProgram_.get(), lightingProgram_.get(), fallbackProgram_.get() }) program->Reload(changed);
+			for (auto program : OptionalPrograms()) program->Reload(changed);
+		}
+		// swaps in every relink that has finished. the frame then picks its programs by Ready().
+		void PollPrograms() {
+			for (auto program : { geometryProgram_.get(), lightingProgram_.get(), fallbackProgram_.get() }) program->Poll();
+			for (auto program : OptionalPrograms()) program->Poll();
+		}
+		// a wave through the stress grid.
+		void AnimateInstances(const unsigned int& tick, std::vector<nr::geometry::Instance>& instances) {
+			instances.resize(baseInstances_.size());
+			const float time = tick * TICKLENGTH;
+			for (unsigned int i = 0; i < baseInstances_.size(); ++i) {
+				nr::geometry::Instance instance = baseInstances_[i];
+				if (animateInstances_) instance.transform_.y += std::sin(time + 0.1f * (instance.transform_.x + instance.transform_.z));
+				instances[i] = instance;
 			}
 		}
+		// nearest first. the instances of one draw rasterize in order, so the front ones fill depth before those they hide.
+		void SortInstances(const glm::vec3& cameraPosition, std::vector<nr::geometry::Instance>& instances) {
+			std::sort(instances.begin(), instances.end(), [&cameraPosition](const nr::geometry::Instance& a, const nr::geometry::Instance& b) {
+				const glm::vec3 toA = glm::vec3(a.transform_) - cameraPosition;
+				const glm::vec3 toB = glm::vec3(b.transform_) - cameraPosition;
+				return glm::dot(toA, toA) < glm::dot(toB, toB);
+			});
+		}
+		// each light circles its origin, at its own speed and phase.
+		void AnimatePointLights(const unsigned int& tick, std::vector<nr::lighting::PointLight>& lights) {
+			const float time = tick * TICKLENGTH;
+			for (unsigned int i = 0; i < pointLightOrigins_.size(); ++i) {
+				const float angle = time * (0.5f + 0.1f * (i % 7)) + i * 2.39996f;
+				lights[i].position_ = pointLightOrigins_[i].position_ + glm::vec3(std::cos(angle), 0.5f * std::sin(2.0f * angle), std::sin(angle)) * 3.0f;
+			}
+		}
+		// copies the snapshot's instances into the mapped stream and points instanceVAO_ at them.
+		void StreamInstances(const FrameSnapshot& frame) {
+			const StreamAllocation allocation = instanceStream_.Write(frame.instances_.data(), sizeof(nr::geometry::Instance) * frame.instances_.size());
+			if (!allocation.Valid()) return;
+			glState_.BindVertexArray(instanceVAO_);
+			BindInstanceAttributes(instanceStream_.ID(), allocation.offset_);
+		}
+		// one fixed step: input, camera and light.
+		void Tick() {
+			InputEvent event;
+			while (input_.Pop(event)) {
+				if (event.type_ == InputEvent::TYPE::CURSOR) {
+					camera_->UpdateMousePosition(event.cursor_);
+					continue;
+				}
+				switch (event.key_) {
+				case GLFW_KEY_S: camera_->MoveSouth(); break;
+				case GLFW_KEY_W: camera_->MoveNorth(); break;
+				case GLFW_KEY_A: camera_->MoveEast(); break;
+				case GLFW_KEY_D: camera_->MoveWest(); break;
+				case GLFW_KEY_RIGHT: camera_->LookRight(); break;
+				}
+			}
+			if (!recordCameraPath_ && !cameraPath_.Empty()) {
+				const nr::driver::CameraPose& pose = cameraPath_.At(tick_);
+				camera_->SetPose(pose.position_, pose.yaw_, pose.pitch_);
+			}
+			if (recordCameraPath_) cameraPath_.Record({ camera_->Position(), camera_->Yaw(), camera_->Pitch() });
+
+			const float radius{ 50 };
+			const float frequency{ 0.0000000001 };
+			lightSource_.position_ = glm::vec3(radius * sin(frequency + tick_ / pow(2, 12)), 0, radius * cos(frequency + tick_ / pow(2, 12)));
+			++tick_;
+		}
+		// each lod sphere's level for this camera. a level's error is in the unit sphere's units, so it is allowed
+		// lodPixelError_ pixels over how many pixels a unit of the sphere covers at its nearest point.
+		void SelectSphereLevels(const glm::vec3& cameraPosition, FrameSnapshot& frame) {
+			frame.lodStats_ = {};
+			frame.sphereLevels_.resize(lodSpheres_.size());
+			if (lodSpheres_.empty()) return;
+			const float pixelsPerUnit = projectionMatrix_[1][1] * framebufferSize_.y * 0.5f;
+			const unsigned int fullTriangles = sphereLOD_.levels_.front().indexCount_ / 3;
+			for (std::size_t i = 0; i < lodSpheres_.size(); ++i) {
+				const LODProp& sphere = lodSpheres_[i];
+				// no nearer than the near plane, where the projection stops.
+				const float distance = std::max(glm::length(sphere.position_ - cameraPosition) - sphere.radius_, 0.1f);
+				const float maxError = lodPixelError_ * distance / (pixelsPerUnit * sphere.radius_);
+				if (meshLOD_) sphereLevels_[i] = nr::geometry::SelectLOD(sphereLOD_, sphereLevels_[i], maxError, LODHYSTERESIS);
+				else sphereLevels_[i] = 0;
+				frame.sphereLevels_[i] = sphereLevels_[i];
+				frame.lodStats_.triangles_ += sphereLOD_.levels_[sphereLevels_[i]].indexCount_ / 3;
+				frame.lodStats_.fullTriangles_ += fullTriangles;
+				frame.lodStats_.simplified_ += sphereLevels_[i] != 0;
+			}
+		}
+		// the current state, and everything derived from it, into the snapshot being written.
+		void WriteSnapshot() {
+			FrameSnapshot& frame = snapshots_.Back();
+			const glm::mat4 viewMatrix = glm::lookAt(camera_->Position(), camera_->Position() + camera_->Front(), camera_->Up());
+			frame.block_ = {
+				viewMatrix,
+				projectionMatrix_,
+				glm::vec4(camera_->Position(), 1.0f),
+				glm::vec4(lightSource_.position_, 1.0f),
+				glm::vec4(lightSource_.color_, 1.0f)
+			};
+			frame.lightPosition_ = lightSource_.position_;
+			frame.tick_ = tick_;
+			if (!baseInstances_.empty()) AnimateInstances(tick_, frame.instances_);
+			if (sortInstances_) SortInstances(camera_->Position(), frame.instances_);
+			// assigned even without lights, every cluster then reads an empty list.
+			AnimatePointLights(tick_, pointLights_);
+			clusterGrid_.Assign(pointLights_, viewMatrix, frame.clusters_);
+			CullVisibleShapes(projectionMatrix_ * viewMatrix, frame);
+			SelectSphereLevels(camera_->Position(), frame);
+		}
+		// ticks in real time until running is cleared, publishing a snapshot after each batch.
+		void RunSimulation(const std::atomic<bool>& running) {
+			using Clock = std::chrono::steady_clock;
+			const auto tickLength = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(TICKLENGTH));
+			Clock::time_point next = Clock::now();
+			while (running.load(std::memory_order_acquire)) {
+				unsigned int ticks = 0;
+				for (; ticks < MAXCATCHUP && Clock::now() >= next; ++ticks) {
+					Tick();
+					next += tickLength;
+				}
+				// too far behind, drop the backlog rather than spiral.
+				if (ticks == MAXCATCHUP) next = Clock::now();
+				if (ticks) {
+					WriteSnapshot();
+					snapshots_.Publish();
+				}
+				std::this_thread::sleep_until(next);
+			}
+		}
+		void PrintStreamStats(const char* name, nr::driver::StreamBuffer& stream) {
+			const StreamStats& stats = stream.Stats();
+			std::cout << "streaming " << name << ": " << stats.bytes_ / 1024.0 / STATSINTERVAL << " KB/frame, " << stats.waits_ << " waits, " << stats.overflows_ << " overflows" << (stream.Persistent() ? "" : " (unsynchronized maps)") << std::endl;
+			stream.ResetStats();
+		}
+		inline bool Running(const unsigned int& frameNumber) {
+			return headless_ ? frameNumber < benchmarkFrames_ : !glfwWindowShouldClose(window_);
+		}
+		inline void EndFrame() {
+			if (headless_) {
+				glFlush();
+				return;
+			}
+			glfwPollEvents();
+			glfwSwapBuffers(window_);
+		}
 		void Render() {
-			geometryProgram_->Use();
 			projectionMatrix_ = glm::mat4(1.0f);
-			projectionMatrix_ = glm::perspective(glm::radians(45.0f), (float)nr::driver::WINDOWWIDTH / (float)nr::driver::WINDOWHEIGHT, 0.1f, 10000.0f);
-			geometryProgram_->SetUniformMat4("projectionMatrix", projectionMatrix_);
-			geometryProgram_->SetUniformFloat("ambientScale", 0.7f);
+			const float farPlane = 10000.0f;
+			const float aspect = (float)framebufferSize_.x / (float)framebufferSize_.y;
+			projectionMatrix_ = glm::perspective(glm::radians(45.0f), aspect, 0.1f, farPlane);
+			clusterGrid_.Init(glm::radians(45.0f), aspect, 0.1f, farPlane, nr::lighting::ClusterBuffers::MaxTexels());
+
+			// the cluster lookup, only in the lit program.
+			const UniformHandle lightData = geometryProgram_->Handle("lightData");
+			const UniformHandle clusterGrid = geometryProgram_->Handle("clusterGrid");
+			const UniformHandle lightIndices = geometryProgram_->Handle("lightIndices");
+			const UniformHandle clusterCounts = geometryProgram_->Handle("clusterCounts");
+			const UniformHandle clusterScale = geometryProgram_->Handle("clusterScale");
+			const UniformHandle clusterBias = geometryProgram_->Handle("clusterBias");
+			// the deferred passes. the g-buffer samplers sit on consecutive units in both shading programs.
+			const bool deferredEnabled = deferredShading_;
+			UniformHandle emissive, emissiveLit, ambientSamplers[3], volumeSamplers[3], volumeScale, inverseViewProjection;
+			if (deferredEnabled) {
+				emissive = emissiveGBufferProgram_->Handle("emissive");
+				emissiveLit = gBufferProgram_->Handle("emissive");
+				const char* samplers[3] = { "albedoBuffer", "normalBuffer", "depthBuffer" };
+				for (unsigned int i = 0; i < 3; ++i) {
+					ambientSamplers[i] = deferredAmbientProgram_->Handle(samplers[i]);
+					volumeSamplers[i] = lightVolumeProgram_->Handle(samplers[i]);
+				}
+				volumeScale = lightVolumeProgram_->Handle("volumeScale");
+				inverseViewProjection = lightVolumeProgram_->Handle("inverseViewProjection");
+			}
+
+			// the first snapshot is there before the first frame either way.
+			if (headless_) pipelined_ = false;
+			Tick();
+			WriteSnapshot();
+			snapshots_.Publish();
+			std::atomic<bool> simulating{ true };
+			std::thread simulation;
+			if (pipelined_) simulation = std::thread(&RunSimulation, std::cref(simulating));
 
+			// the queue reorders opaque draws, so what ends up in front is left to the depth test.
+			glState_.Enable(GL_DEPTH_TEST);
+			unsigned int frameNumber = 0;
+			double frameStart = nr::util::GetElapsedTime();
+			double frameTimeTotal = 0;
+			// snapshots drawn, and frames that found no new one.
+			unsigned int snapshotsDrawn = 0;
+			unsigned int repeats = 0;
+			while (Running(frameNumber)) {
+				if (benchmark_) frameTimer_.BeginFrame();
+				if (hotReload_) ReloadChangedPrograms();
+				PollPrograms();
+				frameUniforms_.BeginFrame();
+				if (!baseInstances_.empty()) instanceStream_.BeginFrame();
+				if (deferredEnabled && pointLightCount_) volumeStream_.BeginFrame();
+				if (!pipelined_ && frameNumber > 0) {
+					Tick();
+					WriteSnapshot();
+					snapshots_.Publish();
+				}
+				const bool fresh = snapshots_.Acquire();
+				if (fresh) ++snapshotsDrawn;
+				else ++repeats;
+				const FrameSnapshot& frame = snapshots_.Front();
+				if (fresh) clusterBuffers_.Upload(frame.clusters_);
+				// the overdraw view replaces lighting, deferred included.
+				const bool overdraw = overdrawView_ && overdrawProgram_->Ready();
+				const bool prePass = depthPrePass_ && depthProgram_->Ready();
+				// until its programs link, the deferred path draws forward.
+				bool deferred = deferredEnabled && !overdraw;
+				for (auto program : DeferredPrograms()) deferred = deferred && program->Ready();
+				if (deferred) gBuffer_.Bind();
+				{
+					NR_PROFILE_GPU_SCOPE("clear");
+					if (overdraw) glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+					else glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				}
 
-			nr::lighting::LightSource lightSource_;
-			lightSource_.color_ = glm::vec3(1.0f, 1.0f, 1.0f);
+				// one upload per frame, visible to every program bound to FRAMEBLOCKBINDING.
+				frameUniforms_.Update(frame.block_);
 
+				// everything goes through the queue, which binds only what changes between draws.
+				// camera and light state is shared through the FrameBlock buffer, the queue sets model and material.
+				{
+					NR_PROFILE_GPU_SCOPE("draw queue");
+					const bool geometryReady = geometryProgram_->Ready();
+					Program& geometry = overdraw ? *overdrawProgram_ : deferred ? *gBufferProgram_ : geometryReady ? *geometryProgram_ : *fallbackProgram_;
+					// re-set every frame, the uniform cache skips them once they have been uploaded.
+					if (deferred) {
+						gBufferProgram_->Use();
+						gBufferProgram_->SetUniformInt(emissiveLit, 0);
+						emissiveGBufferProgram_->Use();
+						emissiveGBufferProgram_->SetUniformInt(emissive, 1);
+					}
+					else if (geometryReady && !overdraw) {
+						geometry.Use();
+						geometry.SetUniformInt(lightData, CLUSTERTEXTUREUNIT);
+						geometry.SetUniformInt(clusterGrid, CLUSTERTEXTUREUNIT + 1);
+						geometry.SetUniformInt(lightIndices, CLUSTERTEXTUREUNIT + 2);
+						geometry.SetUniformVec3(clusterCounts, clusterGrid_.Counts());
+						geometry.SetUniformVec3(clusterScale, clusterGrid_.Scale(framebufferSize_.x, framebufferSize_.y));
+						geometry.SetUniformFloat(clusterBias, clusterGrid_.DepthBias());
+					}
+					Program& lighting = overdraw ? *overdrawProgram_ : deferred ? *emissiveGBufferProgram_ : lightingProgram_->Ready() ? *lightingProgram_ : *fallbackProgram_;
+					renderQueue_.Begin(glm::vec3(frame.block_.cameraPosition_), farPlane);
 
-			
-			int frameNumber = 0;
-			while (!glfwWindowShouldClose(window_)) {
-				glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
-				glClear(GL_COLOR_BUFFER_BIT);
-
-				glm::mat4 viewMatrix_ = glm::mat4(1.0f);
-				viewMatrix_ = glm::lookAt(camera_->Position(), camera_->Position() + camera_->Front(), camera_->Up());
-				glm::mat4 modelMatrix_ = glm::mat4(1.0f);
-
-				// props.
-				geometryProgram_->Use();
-				geometryProgram_->SetUniformMat4("viewMatrix", viewMatrix_);
-				geometryProgram_->SetUniformMat4("modelMatrix", modelMatrix_);
-
-				geometryProgram_->SetUniformVec3("objectColor", { 0.2f, 0.7f, 0.0f });
-
-				const float radius{ 50 };
-				const float frequency{ 0.0000000001 };
-				lightSource_.position_ = glm::vec3(radius * sin(frequency + frameNumber / pow(2, 12)), 0, radius * cos(frequency + frameNumber / pow(2, 12)));
-				
-				geometryProgram_->SetUniformVec3("lightPosition", lightSource_.position_);
-				geometryProgram_->SetUniformVec3("lightColor", lightSource_.color_);
-				glBindVertexArray(VAO_);
-				glDrawElements(GL_TRIANGLES, nr::driver::INDEXCOUNT , GL_UNSIGNED_INT, (void*)(0 * sizeof(unsigned int)));
-
-				// lighting
-				lightingProgram_->Use();
-				modelMatrix_ = glm::translate(modelMatrix_, lightSource_.position_);
-				lightingProgram_->SetUniformMat4("modelMatrix", modelMatrix_);
-				geometryProgram_->SetUniformMat4("viewMatrix", viewMatrix_);
-				lightingProgram_->SetUniformMat4("projectionMatrix", projectionMatrix_);
-
-				glDrawElements(GL_TRIANGLES, nr::driver::INDEXCOUNT, GL_UNSIGNED_INT, (void*)(0 * sizeof(unsigned int)));
-
-
-				glfwPollEvents();
-				glfwSwapBuffers(window_);
+					// props.
+					if (!frame.drawCounts_.empty()) {
+						renderQueue_.Add(geometry, VAO_, sceneMaterial_, glm::mat4(1.0f), DrawCommand::Multi(frame.drawCounts_.data(), frame.drawOffsets_.data(), frame.drawCounts_.size(), INDEXTYPE), sceneBounds_.Center());
+					}
+					// every instanced cube in one call.
+					// streamed instances may have been culled down to fewer.
+					const GLsizei instanceCount = baseInstances_.empty() ? nr::driver::INSTANCECOUNT : frame.instances_.size();
+					if (instanceCount) {
+						if (!baseInstances_.empty()) StreamInstances(frame);
+						renderQueue_.Add(geometry, instanceVAO_, whiteMaterial_, glm::mat4(1.0f), DrawCommand::Instanced(nr::driver::CUBEINDEXCOUNT, GL_UNSIGNED_INT, instanceCount), instanceBounds_.Center());
+					}
+					for (const Prop& prop : props_) renderQueue_.Add(prop.lit_ ? geometry : lighting, prop.VAO_, prop.material_, prop.model_, prop.command_, prop.position_);
+					for (std::size_t i = 0; i < lodSpheres_.size(); ++i) {
+						const LODProp& sphere = lodSpheres_[i];
+						const nr::geometry::LODLevel& level = sphereLOD_.levels_[frame.sphereLevels_[i]];
+						const glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), sphere.position_), glm::vec3(sphere.radius_));
+						renderQueue_.Add(geometry, sphereVAO_, sphere.material_, model, DrawCommand::Elements(level.indexCount_, GL_UNSIGNED_INT, (void*)(std::size_t(level.firstIndex_) * sizeof(unsigned int))), sphere.position_);
+					}
+					// lighting
+					renderQueue_.Add(lighting, lightVAO_, whiteMaterial_, glm::translate(glm::mat4(1.0f), frame.lightPosition_), DrawCommand::Elements(nr::driver::CUBEINDEXCOUNT, GL_UNSIGNED_INT), frame.lightPosition_);
+
+					if (prePass) {
+						NR_PROFILE_GPU_SCOPE("depth pre-pass");
+						// leaves the queue nearest first, which is also what an unsorted frame then submits in.
+						renderQueue_.SortFrontToBack();
+						glState_.ColorMask(GL_FALSE);
+						renderQueue_.SubmitDepthOnly(*depthProgram_);
+						glState_.ColorMask(GL_TRUE);
+						// depth is final, only the fragment that wrote it passes.
+						glState_.DepthFunc(GL_EQUAL);
+						glState_.DepthMask(GL_FALSE);
+					}
+					if (overdraw) {
+						glState_.Enable(GL_BLEND);
+						glState_.BlendFunc(GL_ONE, GL_ONE);
+					}
+					if (sortDraws_) renderQueue_.Sort();
+					if (countOverdraw_) fragmentCounter_.Begin();
+					renderQueue_.Submit();
+					if (countOverdraw_) fragmentCounter_.End();
+					if (overdraw) glState_.Disable(GL_BLEND);
+					if (prePass) {
+						glState_.DepthFunc(GL_LESS);
+						glState_.DepthMask(GL_TRUE);
+					}
+				}
+				if (deferred) {
+					NR_PROFILE_GPU_SCOPE("deferred shading");
+					// the scene's depth, for the light volumes to test against.
+					gBuffer_.BlitDepth(defaultFramebuffer_);
+					glClear(GL_COLOR_BUFFER_BIT);
+					// the ambient pass covers every pixel.
+					glState_.Disable(GL_DEPTH_TEST);
+					deferredAmbientProgram_->Use();
+					for (unsigned int i = 0; i < 3; ++i) deferredAmbientProgram_->SetUniformInt(ambientSamplers[i], GBUFFERTEXTUREUNIT + i);
+					glState_.BindVertexArray(fullscreenVAO_);
+					glDrawArrays(GL_TRIANGLES, 0, 3);
+
+					const std::vector<glm::vec4>& lights = frame.clusters_.lights_;
+					const StreamAllocation allocation = lights.empty() ? StreamAllocation{} : volumeStream_.Write(lights.data(), sizeof(glm::vec4) * lights.size());
+					if (allocation.Valid()) {
+						lightVolumeProgram_->Use();
+						for (unsigned int i = 0; i < 3; ++i) lightVolumeProgram_->SetUniformInt(volumeSamplers[i], GBUFFERTEXTUREUNIT + i);
+						lightVolumeProgram_->SetUniformFloat(volumeScale, 1.0f / nr::geometry::Icosahedron::INRADIUS);
+						lightVolumeProgram_->SetUniformMat4(inverseViewProjection, glm::inverse(frame.block_.projectionMatrix_ * frame.block_.viewMatrix_));
+						glState_.BindVertexArray(volumeVAO_);
+						BindLightAttributes(volumeStream_.ID(), allocation.offset_);
+						// back faces, so a volume still shades with the camera inside it. only where they are behind the
+						// surface does the surface lie in front of the volume's far side, pixels with it farther are skipped.
+						glState_.Enable(GL_BLEND);
+						glState_.BlendFunc(GL_ONE, GL_ONE);
+						glState_.Enable(GL_CULL_FACE);
+						glCullFace(GL_FRONT);
+						glState_.Enable(GL_DEPTH_TEST);
+						glState_.DepthFunc(GL_GEQUAL);
+						glState_.DepthMask(GL_FALSE);
+						glDrawElementsInstanced(GL_TRIANGLES, VOLUMEINDEXCOUNT, GL_UNSIGNED_INT, 0, lights.size() / 2);
+						glState_.DepthFunc(GL_LESS);
+						glState_.DepthMask(GL_TRUE);
+						glState_.Disable(GL_CULL_FACE);
+						glState_.Disable(GL_BLEND);
+					}
+					glState_.Enable(GL_DEPTH_TEST);
+				}
+
+
+				// every draw reading this frame's stream regions has been issued.
+				frameUniforms_.EndFrame();
+				if (!baseInstances_.empty()) instanceStream_.EndFrame();
+				if (deferredEnabled && pointLightCount_) volumeStream_.EndFrame();
+				{
+					NR_PROFILE_GPU_SCOPE("swap");
+					EndFrame();
+				}
+				NR_PROFILE_FRAME();
+#if defined(NR_VALIDATE_STATE)
+				glState_.Validate();
+#endif
+				if (benchmark_) frameTimer_.EndFrame();
 				++frameNumber;
+
+				const double frameEnd = nr::util::GetElapsedTime();
+				frameTimeTotal += frameEnd - frameStart;
+				frameStart = frameEnd;
+				if (stressMode_ && frameNumber % STATSINTERVAL == 0) {
+					std::cout << "stress: " << nr::driver::INSTANCECOUNT << " instances, " << 1000.0 * frameTimeTotal / STATSINTERVAL << " ms/frame" << std::endl;
+					frameTimeTotal = 0;
+				}
+
+				UniformStats uniformStats = geometryProgram_->Stats();
+				uniformStats += lightingProgram_->Stats();
+				uniformStats += fallbackProgram_->Stats();
+				for (auto program : OptionalPrograms()) uniformStats += program->Stats();
+				if (printStats_ && frameNumber % STATSINTERVAL == 0) {
+					std::cout << "uniforms: " << uniformStats.uploads_ << " uploaded, " << uniformStats.elided_ << " elided" << std::endl;
+					std::cout << "culling: " << frame.cullStats_.visible_ << " visible, " << frame.cullStats_.culled_ << " culled, " << frame.cullStats_.tests_ << " box tests" << std::endl;
+					const nr::lighting::ClusterStats& clusterStats = frame.clusters_.stats_;
+					std::cout << "clusters: " << clusterStats.lights_ << " lights, " << clusterStats.visible_ << " visible, " << clusterStats.references_ << " references, at most " << clusterStats.busiestCluster_ << " in a cluster, " << clusterStats.overflows_ << " dropped" << std::endl;
+					const StateStats& stateStats = glState_.Stats();
+					std::cout << "gl state: " << stateStats.issued_ << " calls issued, " << stateStats.redundant_ << " redundant skipped, " << stateStats.desyncs_ << " desyncs" << std::endl;
+					const RenderQueueStats& queueStats = renderQueue_.Stats();
+					std::cout << "draw queue: " << queueStats.items_ << " items, " << queueStats.programSwitches_ << " program, " << queueStats.VAOSwitches_ << " vao, " << queueStats.materialSwitches_ << " material switches (" << queueStats.submissionProgramSwitches_ << ", " << queueStats.submissionVAOSwitches_ << ", " << queueStats.submissionMaterialSwitches_ << " in submission order)" << std::endl;
+					if (occlusionCulling_) {
+						const nr::culling::OcclusionStats& occlusionStats = frame.occlusionStats_;
+						std::cout << "occlusion: " << occlusionStats.occluders_ << " occluders, " << occlusionStats.triangles_ << " triangles, " << occlusionStats.occluded_ << " of " << occlusionStats.tested_ << " occluded, " << occlusionStats.rasterMilliseconds_ << " ms rasterizing, " << occlusionStats.testMilliseconds_ << " ms testing" << std::endl;
+					}
+					if (lodProps_) {
+						const LODStats& lodStats = frame.lodStats_;
+						std::cout << "lod: " << queueStats.triangles_ << " triangles submitted, " << queueStats.triangles_ - lodStats.triangles_ + lodStats.fullTriangles_ << " without lod, " << lodStats.simplified_ << " of " << lodSpheres_.size() << " spheres simplified" << std::endl;
+					}
+					if (countOverdraw_) {
+						const double fragments = fragmentCounter_.Average();
+						std::cout << "overdraw: " << fragments << " fragments shaded a frame, " << fragments / (double(framebufferSize_.x) * framebufferSize_.y) << " a pixel" << (prePass ? " after the depth pre-pass" : "") << std::endl;
+						fragmentCounter_.Reset();
+					}
+					if (deferred) std::cout << "deferred: " << gBuffer_.Width() << "x" << gBuffer_.Height() << " g-buffer, " << gBuffer_.Width() * gBuffer_.Height() * nr::lighting::GBuffer::BYTESPERPIXEL / 1024 << " KiB, " << frame.clusters_.lights_.size() / 2 << " light volumes" << std::endl;
+					std::cout << "pipeline: tick " << frame.tick_ << ", " << snapshotsDrawn << " snapshots drawn, " << repeats << " frames repeated the last one" << std::endl;
+					snapshotsDrawn = 0;
+					repeats = 0;
+					PrintStreamStats("uniforms", frameUniforms_.Stream());
+					if (!baseInstances_.empty()) PrintStreamStats("instances", instanceStream_);
+					NR_PROFILE_REPORT(std::cout);
+				}
+				geometryProgram_->ResetStats();
+				lightingProgram_->ResetStats();
+				fallbackProgram_->ResetStats();
+				for (auto program : OptionalPrograms()) program->ResetStats();
+				glState_.ResetStats();
+			}
+			simulating.store(false, std::memory_order_release);
+			if (simulation.joinable()) simulation.join();
+			if (benchmark_) {
+				frameTimer_.Finish();
+				frameTimer_.Report(std::cout);
+				if (!benchmarkOutput_.empty() && !frameTimer_.SaveCSV(benchmarkOutput_)) std::cout << "could not write " << benchmarkOutput_ << std::endl;
 			}
+#if defined(NR_PROFILE)
+			if (!profileTraceFile_.empty() && !NR_PROFILE_DUMP(profileTraceFile_)) std::cout << "could not write " << profileTraceFile_ << std::endl;
+#endif
+			if (recordCameraPath_ && !cameraPath_.Save(cameraPathFile_)) std::cout << "could not save camera path " << cameraPathFile_ << std::endl;
 		}
 	}
 
@@ -6,64 +6,172 @@
 #include <array>
 #include <vector>
 #include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include "VertexFormat.h"
 
 
 namespace nr {
 	namespace geometry {
+		struct AABB {
+			glm::vec3 min_{ std::numeric_limits<float>::max() };
+			glm::vec3 max_{ -std::numeric_limits<float>::max() };
+			inline void Grow(const glm::vec3& point) {
+				min_ = glm::min(min_, point);
+				max_ = glm::max(max_, point);
+			}
+			inline void Grow(const AABB& other) {
+				min_ = glm::min(min_, other.min_);
+				max_ = glm::max(max_, other.max_);
+			}
+			inline glm::vec3 Center() const { return (min_ + max_) * 0.5f; }
+			inline glm::vec3 Extent() const { return (max_ - min_) * 0.5f; }
+		};
+		// per-instance attributes for instanced draws. xyz offset and w uniform scale, color as normalized bytes.
+		struct Instance {
+			glm::vec4 transform_;
+			std::uint32_t color_;
+		};
 		template<typename VertexType>
 		class Shape {
 		protected:
-	
+			inline void AddVertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& color) {
+				vertices.push_back(nr::vertex::Layout<VertexType>::Pack(position, normal, color));
+			}
 		public:
-			std::vector<float> vertices;
+			using vertex_type = VertexType;
+			std::vector<VertexType> vertices;
 			std::vector<unsigned int> indices;
 			Shape(const unsigned int& nPoints)
 			:vertices(nPoints){
 			}
 			Shape() {
 			}
+			inline glm::vec3 Position(const unsigned int& vertex) const {
+				return nr::vertex::Layout<VertexType>::Unpack(vertices[vertex]);
+			}
+			AABB Bounds() const {
+				AABB bounds;
+				for (unsigned int i = 0; i < vertices.size(); ++i) bounds.Grow(Position(i));
+				return bounds;
+			}
 		};
-		class Cube : public nr::geometry::Shape<glm::vec3> {
+		template<typename VertexType>
+		class BasicCube : public nr::geometry::Shape<VertexType> {
 		public:
-			Cube(const glm::vec3& f1botLeft, const float& sideDim)
+			BasicCube(const glm::vec3& f1botLeft, const float& sideDim, const glm::vec3& color = glm::vec3(1.0f))
 				{
-				
-				for (unsigned int i = 0; i < 2; ++i) {
-					float faceOffset{ (i % 2) * sideDim };
-					vertices.insert(vertices.end(), { f1botLeft.x,f1botLeft.y,f1botLeft.z + faceOffset });
-					vertices.insert(vertices.end(), { f1botLeft.x + sideDim,f1botLeft.y,f1botLeft.z + faceOffset });
-					vertices.insert(vertices.end(), { f1botLeft.x + sideDim,f1botLeft.y + sideDim,f1botLeft.z + faceOffset });
-					vertices.insert(vertices.end(), { f1botLeft.x ,f1botLeft.y + sideDim,f1botLeft.z + faceOffset });
+				// each face gets its own 4 vertices so it can carry a flat normal.
+				// (normal, u, v) with u x v = normal, which keeps every face counter clockwise from outside.
+				const std::array<std::array<glm::vec3, 3>, 6> faces = { {
+					//front
+					{ glm::vec3(0, 0, -1), glm::vec3(0, 1, 0), glm::vec3(1, 0, 0) },
+					// back
+					{ glm::vec3(0, 0, 1), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0) },
+					// top
+					{ glm::vec3(0, 1, 0), glm::vec3(0, 0, 1), glm::vec3(1, 0, 0) },
+					// bottom
+					{ glm::vec3(0, -1, 0), glm::vec3(1, 0, 0), glm::vec3(0, 0, 1) },
+					// left
+					{ glm::vec3(-1, 0, 0), glm::vec3(0, 0, 1), glm::vec3(0, 1, 0) },
+					// right
+					{ glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1) }
+				} };
+				const float halfDim{ sideDim * 0.5f };
+				const glm::vec3 center = f1botLeft + glm::vec3(halfDim);
+				for (const auto& face : faces) {
+					const glm::vec3& normal = face[0];
+					const glm::vec3& u = face[1];
+					const glm::vec3& v = face[2];
+					const unsigned int base = this->vertices.size();
+					this->AddVertex(center + halfDim * (normal - u - v), normal, color);
+					this->AddVertex(center + halfDim * (normal + u - v), normal, color);
+					this->AddVertex(center + halfDim * (normal + u + v), normal, color);
+					this->AddVertex(center + halfDim * (normal - u + v), normal, color);
+					this->indices.insert(this->indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
 				}
-
-
-				indices.insert(indices.end(),
-					{
-						//front
-						0,1,2,
-						0,3,2,
-						// back
-						4,5,6,
-						4,7,6,
-						// top
-						3,2,6,
-						3,7,6,
-						// bottom
-						0,1,5,
-						0,4,5,
-						// left
-						4,0,3,
-						4,7,3,
-						// right
-						1,2,6,
-						1,5,6
-					});
-			
 			}
-			static float VertexCount() {
-				return 8;
+			static constexpr unsigned int VertexCount() {
+				return 24;
 			}
 
 		};
+		// the coarsest sphere, for bounding volumes. faces are wound counter clockwise from outside.
+		template<typename VertexType>
+		class BasicIcosahedron : public nr::geometry::Shape<VertexType> {
+		public:
+			// inradius over circumradius. scale by its inverse to contain a sphere rather than sit inside one.
+			static constexpr float INRADIUS = 0.7946545f;
+			BasicIcosahedron(const glm::vec3& center, const float& radius, const glm::vec3& color = glm::vec3(1.0f)) {
+				const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+				const std::array<glm::vec3, 12> corners = { {
+					{ -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+					{ 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+					{ t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 }
+				} };
+				for (const glm::vec3& corner : corners) {
+					const glm::vec3 normal = glm::normalize(corner);
+					this->AddVertex(center + normal * radius, normal, color);
+				}
+				const std::array<std::array<unsigned int, 3>, 20> faces = { {
+					{ 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+					{ 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+					{ 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+					{ 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+				} };
+				for (const auto& face : faces) {
+					const glm::vec3& a = corners[face[0]];
+					const glm::vec3& b = corners[face[1]];
+					const glm::vec3& c = corners[face[2]];
+					// outward facing if the face normal agrees with the direction to the face.
+					if (glm::dot(glm::cross(b - a, c - a), a + b + c) >= 0.0f) this->indices.insert(this->indices.end(), { face[0], face[1], face[2] });
+					else this->indices.insert(this->indices.end(), { face[0], face[2], face[1] });
+				}
+			}
+		};
+		// an icosahedron with each face split in four, subdivisions times over, and pushed out onto the sphere.
+		// 20 * 4^subdivisions triangles over shared vertices, so it simplifies well. counter clockwise from outside.
+		template<typename VertexType>
+		class BasicSphere : public nr::geometry::Shape<VertexType> {
+		public:
+			BasicSphere(const glm::vec3& center, const float& radius, const unsigned int& subdivisions, const glm::vec3& color = glm::vec3(1.0f)) {
+				const BasicIcosahedron<nr::vertex::Position> base(glm::vec3(0.0f), 1.0f);
+				std::vector<glm::vec3> directions;
+				for (unsigned int i = 0; i < base.vertices.size(); ++i) directions.push_back(base.Position(i));
+				std::vector<unsigned int> faces = base.indices;
+				for (unsigned int level = 0; level < subdivisions; ++level) {
+					// neighbouring faces share the vertex split into their common edge.
+					std::unordered_map<std::uint64_t, unsigned int> midpoints;
+					auto midpoint = [&](const unsigned int& a, const unsigned int& b) {
+						const std::uint64_t edge = (std::uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+						auto found = midpoints.find(edge);
+						if (found != midpoints.end()) return found->second;
+						directions.push_back(glm::normalize(directions[a] + directions[b]));
+						midpoints.emplace(edge, directions.size() - 1);
+						return static_cast<unsigned int>(directions.size() - 1);
+					};
+					std::vector<unsigned int> split;
+					split.reserve(faces.size() * 4);
+					for (unsigned int i = 0; i < faces.size(); i += 3) {
+						const unsigned int a = faces[i];
+						const unsigned int b = faces[i + 1];
+						const unsigned int c = faces[i + 2];
+						const unsigned int ab = midpoint(a, b);
+						const unsigned int bc = midpoint(b, c);
+						const unsigned int ca = midpoint(c, a);
+						split.insert(split.end(), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca });
+					}
+					faces.swap(split);
+				}
+				for (const glm::vec3& direction : directions) this->AddVertex(center + direction * radius, direction, color);
+				this->indices = std::move(faces);
+			}
+		};
+		using Cube = BasicCube<nr::vertex::PackedLit>;
+		// cubes built at their world position, as the static batch bakes them. half floats would crack them apart.
+		using WorldCube = BasicCube<nr::vertex::WorldLit>;
+		using Icosahedron = BasicIcosahedron<nr::vertex::PackedLit>;
+		using Sphere = BasicSphere<nr::vertex::PackedLit>;
 	}
 }
\ No newline at end of file
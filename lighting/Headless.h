@@ -0,0 +1,98 @@
+#pragma once
+#include <glad/glad.h>
+#include <iostream>
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// offscreen rendering without a window or display server. an egl context with no surface
+// (mesa's surfaceless platform, so llvmpipe works on gpu-less machines) draws into an fbo.
+namespace nr {
+	namespace headless {
+#if defined(__linux__)
+		EGLDisplay display_ = EGL_NO_DISPLAY;
+		EGLContext context_ = EGL_NO_CONTEXT;
+#endif
+		GLuint framebuffer_ = 0;
+		GLuint colorBuffer_ = 0;
+		GLuint depthBuffer_ = 0;
+
+		bool InitContext() {
+#if defined(__linux__)
+			auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+			if (getPlatformDisplay) display_ = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+			if (display_ == EGL_NO_DISPLAY) display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+			EGLint major, minor;
+			if (display_ == EGL_NO_DISPLAY || !eglInitialize(display_, &major, &minor) || !eglBindAPI(EGL_OPENGL_API)) {
+				std::cout << "headless: no egl display" << std::endl;
+				return false;
+			}
+			const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+			EGLConfig config;
+			EGLint configCount = 0;
+			eglChooseConfig(display_, configAttributes, &config, 1, &configCount);
+			const EGLint contextAttributes[] = {
+				EGL_CONTEXT_MAJOR_VERSION, 3,
+				EGL_CONTEXT_MINOR_VERSION, 3,
+				EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+				EGL_NONE
+			};
+			context_ = eglCreateContext(display_, configCount ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+			if (context_ == EGL_NO_CONTEXT || !eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)) {
+				std::cout << "headless: could not create a surfaceless 3.3 core context" << std::endl;
+				return false;
+			}
+			return gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+#else
+			std::cout << "headless: egl is only wired up on linux" << std::endl;
+			return false;
+#endif
+		}
+		// color + depth/stencil renderbuffers, standing in for the window's default framebuffer.
+		bool InitFramebuffer(const unsigned int& width, const unsigned int& height) {
+			glGenFramebuffers(1, &framebuffer_);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+			glGenRenderbuffers(1, &colorBuffer_);
+			glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer_);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer_);
+
+			glGenRenderbuffers(1, &depthBuffer_);
+			glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer_);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer_);
+
+			// a surfaceless context starts with an empty viewport.
+			glViewport(0, 0, width, height);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+				std::cout << "headless: framebuffer incomplete" << std::endl;
+				return false;
+			}
+			return true;
+		}
+		// safe to call twice, or without InitContext having run.
+		void Destroy() {
+#if defined(__linux__)
+			if (display_ == EGL_NO_DISPLAY) return;
+			if (context_ != EGL_NO_CONTEXT) {
+				glDeleteFramebuffers(1, &framebuffer_);
+				glDeleteRenderbuffers(1, &colorBuffer_);
+				glDeleteRenderbuffers(1, &depthBuffer_);
+				eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+				eglDestroyContext(display_, context_);
+			}
+			eglTerminate(display_);
+			display_ = EGL_NO_DISPLAY;
+			context_ = EGL_NO_CONTEXT;
+#endif
+			framebuffer_ = colorBuffer_ = depthBuffer_ = 0;
+		}
+		// runs Destroy at exit. declared ahead of the renderer's globals, so it outlives everything
+		// that still deletes gl objects on its way out.
+		struct Teardown {
+			~Teardown() { Destroy(); }
+		} teardown_;
+	}
+}
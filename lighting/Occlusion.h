@@ -0,0 +1,378 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <array>
+#include <future>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "Geometry.h"
+#include "ThreadPool.h"
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace nr {
+	namespace culling {
+		// per frame.
+		struct OcclusionStats {
+			unsigned int occluders_{ 0 };
+			unsigned int triangles_{ 0 };
+			unsigned int tested_{ 0 };
+			unsigned int occluded_{ 0 };
+			double rasterMilliseconds_{ 0 };
+			double testMilliseconds_{ 0 };
+		};
+
+		// a small depth buffer rasterized on the cpu from a few occluders each frame, so objects hidden behind
+		// them can be dropped before they are submitted. it holds inverse depth, 1/w, which is linear in screen
+		// space and so interpolates exactly: larger is nearer, 0 is nothing drawn. rows are rasterized in bands on
+		// a thread pool, several pixels at a time. min and max pyramids over the buffer then settle most boxes
+		// from a few coarse texels, and the rest from a finer level.
+		class OcclusionBuffer {
+		private:
+			using Clock = std::chrono::steady_clock;
+			static constexpr unsigned int BANDHEIGHT = 16;
+			static constexpr unsigned int LEVELCOUNT = 6;
+			// a box is first tested on the finest level where its rectangle spans at most this many texels a side.
+			static constexpr unsigned int COARSESPAN = 2;
+			// and if that does not settle it, this many levels finer.
+			static constexpr unsigned int REFINELEVELS = 2;
+			struct Triangle {
+				// inclusive pixel bounds, already clamped to the buffer.
+				int minX_;
+				int minY_;
+				int maxX_;
+				int maxY_;
+				// edge functions a*x + b*y + c, non negative inside. inverse depth is a plane of the same form.
+				std::array<float, 3> a_;
+				std::array<float, 3> b_;
+				std::array<float, 3> c_;
+				float depthA_;
+				float depthB_;
+				float depthC_;
+			};
+			struct Level {
+				unsigned int width_;
+				unsigned int height_;
+				// the farthest and nearest occluder under each texel.
+				std::vector<float> min_;
+				std::vector<float> max_;
+			};
+			unsigned int width_{ 0 };
+			unsigned int height_{ 0 };
+			// level 0's min_ is what the triangles are rasterized into.
+			std::vector<Level> levels_;
+			glm::mat4 viewProjection_{ 1.0f };
+			std::vector<glm::vec4> clipPositions_;
+			std::vector<Triangle> triangles_;
+			std::vector<std::future<void>> bands_;
+			OcclusionStats stats_;
+
+			static inline double Milliseconds(const Clock::time_point& from, const Clock::time_point& to) {
+				return std::chrono::duration<double, std::milli>(to - from).count();
+			}
+			inline glm::vec3 ToScreen(const glm::vec4& clip) const {
+				const float inverseW = 1.0f / clip.w;
+				return glm::vec3((clip.x * inverseW * 0.5f + 0.5f) * width_, (clip.y * inverseW * 0.5f + 0.5f) * height_, inverseW);
+			}
+			// screen x, y and inverse depth, counter clockwise. back faces and triangles off every pixel are dropped.
+			// rasterized conservatively inward: a pixel is only written when the triangle covers all of it, and then
+			// with the farthest depth the triangle has over it, so an occluder never hides more than it really does.
+			void SetupTriangle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+				const float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+				if (!(area > 0.0f)) return;
+				Triangle triangle;
+				// pixel i is sampled at its center, i + 0.5, with the edges and depth moved to its least covering corner.
+				triangle.minX_ = std::max(0, static_cast<int>(std::floor(std::min({ p0.x, p1.x, p2.x }))));
+				triangle.minY_ = std::max(0, static_cast<int>(std::floor(std::min({ p0.y, p1.y, p2.y }))));
+				triangle.maxX_ = std::min(static_cast<int>(width_) - 1, static_cast<int>(std::floor(std::max({ p0.x, p1.x, p2.x }))));
+				triangle.maxY_ = std::min(static_cast<int>(height_) - 1, static_cast<int>(std::floor(std::max({ p0.y, p1.y, p2.y }))));
+				if (triangle.minX_ > triangle.maxX_ || triangle.minY_ > triangle.maxY_) return;
+				const std::array<glm::vec3, 3> points = { p0, p1, p2 };
+				for (unsigned int i = 0; i < 3; ++i) {
+					// the inside is left of every edge.
+					const glm::vec3& from = points[i];
+					const glm::vec3& to = points[(i + 1) % 3];
+					triangle.a_[i] = from.y - to.y;
+					triangle.b_[i] = to.x - from.x;
+					triangle.c_[i] = -(triangle.a_[i] * from.x + triangle.b_[i] * from.y) - 0.5f * (std::abs(triangle.a_[i]) + std::abs(triangle.b_[i]));
+				}
+				triangle.depthA_ = ((p1.z - p0.z) * (p2.y - p0.y) - (p2.z - p0.z) * (p1.y - p0.y)) / area;
+				triangle.depthB_ = ((p2.z - p0.z) * (p1.x - p0.x) - (p1.z - p0.z) * (p2.x - p0.x)) / area;
+				triangle.depthC_ = p0.z - triangle.depthA_ * p0.x - triangle.depthB_ * p0.y - 0.5f * (std::abs(triangle.depthA_) + std::abs(triangle.depthB_));
+				triangles_.push_back(triangle);
+			}
+			// clipped to the near plane as gl clips, which also keeps w positive for the divide.
+			void AddTriangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2) {
+				const std::array<glm::vec4, 3> vertices = { v0, v1, v2 };
+				std::array<glm::vec4, 4> polygon;
+				unsigned int count = 0;
+				for (unsigned int i = 0; i < 3; ++i) {
+					const glm::vec4& current = vertices[i];
+					const glm::vec4& next = vertices[(i + 1) % 3];
+					const float currentDistance = current.z + current.w;
+					const float nextDistance = next.z + next.w;
+					if (currentDistance >= 0.0f) polygon[count++] = current;
+					if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) polygon[count++] = current + (next - current) * (currentDistance / (currentDistance - nextDistance));
+				}
+				if (count < 3) return;
+				const glm::vec3 first = ToScreen(polygon[0]);
+				for (unsigned int i = 1; i + 1 < count; ++i) SetupTriangle(first, ToScreen(polygon[i]), ToScreen(polygon[i + 1]));
+			}
+			// keeps the nearer of what is there and the triangle, over the triangle's pixels on row y.
+			void RasterizeSpan(const Triangle& triangle, const int& y) {
+				float* row = levels_[0].min_.data() + y * width_;
+				const float centerY = y + 0.5f;
+				const float row0 = triangle.b_[0] * centerY + triangle.c_[0];
+				const float row1 = triangle.b_[1] * centerY + triangle.c_[1];
+				const float row2 = triangle.b_[2] * centerY + triangle.c_[2];
+				const float rowDepth = triangle.depthB_ * centerY + triangle.depthC_;
+#if defined(__AVX__)
+				// the width is a multiple of 8, so a run started on a multiple of 8 never leaves the row.
+				const __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+				const __m256 zero = _mm256_setzero_ps();
+				for (int x = triangle.minX_ & ~7; x <= triangle.maxX_; x += 8) {
+					const __m256 centerX = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), offsets);
+					const __m256 edge0 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.a_[0]), centerX), _mm256_set1_ps(row0));
+					const __m256 edge1 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.a_[1]), centerX), _mm256_set1_ps(row1));
+					const __m256 edge2 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.a_[2]), centerX), _mm256_set1_ps(row2));
+					const __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(edge0, zero, _CMP_GE_OQ), _mm256_cmp_ps(edge1, zero, _CMP_GE_OQ)), _mm256_cmp_ps(edge2, zero, _CMP_GE_OQ));
+					if (!_mm256_movemask_ps(inside)) continue;
+					const __m256 depth = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.depthA_), centerX), _mm256_set1_ps(rowDepth));
+					const __m256 current = _mm256_loadu_ps(row + x);
+					_mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_max_ps(current, depth), inside));
+				}
+#elif defined(__SSE2__) || defined(_M_X64)
+				const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+				const __m128 zero = _mm_setzero_ps();
+				for (int x = triangle.minX_ & ~3; x <= triangle.maxX_; x += 4) {
+					const __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets);
+					const __m128 edge0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.a_[0]), centerX), _mm_set1_ps(row0));
+					const __m128 edge1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.a_[1]), centerX), _mm_set1_ps(row1));
+					const __m128 edge2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.a_[2]), centerX), _mm_set1_ps(row2));
+					const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)), _mm_cmpge_ps(edge2, zero));
+					if (!_mm_movemask_ps(inside)) continue;
+					const __m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depthA_), centerX), _mm_set1_ps(rowDepth));
+					const __m128 current = _mm_loadu_ps(row + x);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, _mm_max_ps(current, depth)), _mm_andnot_ps(inside, current)));
+				}
+#else
+				for (int x = triangle.minX_; x <= triangle.maxX_; ++x) {
+					const float centerX = x + 0.5f;
+					if (triangle.a_[0] * centerX + row0 < 0.0f || triangle.a_[1] * centerX + row1 < 0.0f || triangle.a_[2] * centerX + row2 < 0.0f) continue;
+					row[x] = std::max(row[x], triangle.depthA_ * centerX + rowDepth);
+				}
+#endif
+			}
+			// rows [firstRow, endRow). bands never share a row, so they need no locking.
+			void RasterizeBand(const unsigned int& firstRow, const unsigned int& endRow) {
+				for (const Triangle& triangle : triangles_) {
+					const int minY = std::max(triangle.minY_, static_cast<int>(firstRow));
+					const int maxY = std::min(triangle.maxY_, static_cast<int>(endRow) - 1);
+					for (int y = minY; y <= maxY; ++y) RasterizeSpan(triangle, y);
+				}
+			}
+			void BuildPyramid() {
+				levels_[0].max_ = levels_[0].min_;
+				for (unsigned int level = 1; level < levels_.size(); ++level) {
+					const Level& finer = levels_[level - 1];
+					Level& coarser = levels_[level];
+					for (unsigned int y = 0; y < coarser.height_; ++y) {
+						// odd sizes fold their last row or column into the texel before.
+						const unsigned int y0 = y * 2;
+						const unsigned int y1 = std::min(y0 + 1, finer.height_ - 1);
+						for (unsigned int x = 0; x < coarser.width_; ++x) {
+							const unsigned int x0 = x * 2;
+							const unsigned int x1 = std::min(x0 + 1, finer.width_ - 1);
+							const std::array<unsigned int, 4> texels = { y0 * finer.width_ + x0, y0 * finer.width_ + x1, y1 * finer.width_ + x0, y1 * finer.width_ + x1 };
+							float farthest = finer.min_[texels[0]];
+							float nearest = finer.max_[texels[0]];
+							for (const unsigned int& texel : texels) {
+								farthest = std::min(farthest, finer.min_[texel]);
+								nearest = std::max(nearest, finer.max_[texel]);
+							}
+							coarser.min_[y * coarser.width_ + x] = farthest;
+							coarser.max_[y * coarser.width_ + x] = nearest;
+						}
+					}
+				}
+			}
+#if defined(__AVX__)
+			static inline float HorizontalMin(const __m256& values) {
+				__m128 folded = _mm_min_ps(_mm256_castps256_ps128(values), _mm256_extractf128_ps(values, 1));
+				folded = _mm_min_ps(folded, _mm_movehl_ps(folded, folded));
+				return _mm_cvtss_f32(_mm_min_ss(folded, _mm_shuffle_ps(folded, folded, 1)));
+			}
+			static inline float HorizontalMax(const __m256& values) {
+				__m128 folded = _mm_max_ps(_mm256_castps256_ps128(values), _mm256_extractf128_ps(values, 1));
+				folded = _mm_max_ps(folded, _mm_movehl_ps(folded, folded));
+				return _mm_cvtss_f32(_mm_max_ss(folded, _mm_shuffle_ps(folded, folded, 1)));
+			}
+#endif
+			bool Test(const nr::geometry::AABB& box) const {
+				float minX = std::numeric_limits<float>::max();
+				float minY = std::numeric_limits<float>::max();
+				float maxX = -std::numeric_limits<float>::max();
+				float maxY = -std::numeric_limits<float>::max();
+				// the box's nearest point is always a corner.
+				float nearest = 0.0f;
+				// the corners are min_ plus the matrix columns scaled by the box's size, one transform is enough.
+				const glm::vec3 size = box.max_ - box.min_;
+				const glm::vec4 origin = viewProjection_ * glm::vec4(box.min_, 1.0f);
+				const glm::vec4 stepX = viewProjection_[0] * size.x;
+				const glm::vec4 stepY = viewProjection_[1] * size.y;
+				const glm::vec4 stepZ = viewProjection_[2] * size.z;
+#if defined(__AVX__)
+				// all 8 corners at once, corner i in lane i.
+				const __m256 cornerX = _mm256_setr_ps(0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f);
+				const __m256 cornerY = _mm256_setr_ps(0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+				const __m256 cornerZ = _mm256_setr_ps(0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f);
+				auto component = [&](const int& i) {
+					return _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(origin[i]), _mm256_mul_ps(cornerX, _mm256_set1_ps(stepX[i]))),
+						_mm256_add_ps(_mm256_mul_ps(cornerY, _mm256_set1_ps(stepY[i])), _mm256_mul_ps(cornerZ, _mm256_set1_ps(stepZ[i]))));
+				};
+				const __m256 clipZ = component(2);
+				const __m256 clipW = component(3);
+				// reaching past the near plane, it could cover anything.
+				if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(clipZ, clipW), _mm256_setzero_ps(), _CMP_LT_OQ))) return true;
+				const __m256 inverseW = _mm256_div_ps(_mm256_set1_ps(1.0f), clipW);
+				const __m256 half = _mm256_set1_ps(0.5f);
+				const __m256 screenX = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(component(0), inverseW), half), half), _mm256_set1_ps(static_cast<float>(width_)));
+				const __m256 screenY = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(component(1), inverseW), half), half), _mm256_set1_ps(static_cast<float>(height_)));
+				minX = HorizontalMin(screenX);
+				maxX = HorizontalMax(screenX);
+				minY = HorizontalMin(screenY);
+				maxY = HorizontalMax(screenY);
+				nearest = HorizontalMax(inverseW);
+#else
+				for (unsigned int corner = 0; corner < 8; ++corner) {
+					glm::vec4 clip = origin;
+					if (corner & 1) clip = clip + stepX;
+					if (corner & 2) clip = clip + stepY;
+					if (corner & 4) clip = clip + stepZ;
+					// reaching past the near plane, it could cover anything.
+					if (clip.z < -clip.w) return true;
+					const glm::vec3 screen = ToScreen(clip);
+					minX = std::min(minX, screen.x);
+					minY = std::min(minY, screen.y);
+					maxX = std::max(maxX, screen.x);
+					maxY = std::max(maxY, screen.y);
+					nearest = std::max(nearest, screen.z);
+				}
+#endif
+				// off screen is for frustum culling to decide.
+				if (maxX < 0.0f || maxY < 0.0f || minX >= width_ || minY >= height_) return true;
+				const unsigned int x0 = static_cast<unsigned int>(std::max(0.0f, minX));
+				const unsigned int y0 = static_cast<unsigned int>(std::max(0.0f, minY));
+				const unsigned int x1 = std::min(width_ - 1, static_cast<unsigned int>(maxX));
+				const unsigned int y1 = std::min(height_ - 1, static_cast<unsigned int>(maxY));
+
+				unsigned int level = 0;
+				while (level + 1 < levels_.size() && ((x1 >> level) - (x0 >> level) >= COARSESPAN || (y1 >> level) - (y0 >> level) >= COARSESPAN)) ++level;
+				const Level& coarse = levels_[level];
+				float farthest = std::numeric_limits<float>::max();
+				float nearestOccluder = 0.0f;
+				for (unsigned int y = y0 >> level; y <= (y1 >> level); ++y) {
+					for (unsigned int x = x0 >> level; x <= (x1 >> level); ++x) {
+						farthest = std::min(farthest, coarse.min_[y * coarse.width_ + x]);
+						nearestOccluder = std::max(nearestOccluder, coarse.max_[y * coarse.width_ + x]);
+					}
+				}
+				// in front of everything there, or behind all of it.
+				if (nearest >= nearestOccluder) return true;
+				if (nearest < farthest) return false;
+
+				level = level > REFINELEVELS ? level - REFINELEVELS : 0;
+				const Level& fine = levels_[level];
+				for (unsigned int y = y0 >> level; y <= (y1 >> level); ++y) {
+					for (unsigned int x = x0 >> level; x <= (x1 >> level); ++x) {
+						if (nearest >= fine.min_[y * fine.width_ + x]) return true;
+					}
+				}
+				return false;
+			}
+		public:
+			// the width is rounded up to a multiple of 8, so whole runs of pixels fit in a row.
+			void Init(const unsigned int& width, const unsigned int& height) {
+				width_ = (std::max(width, 1u) + 7) & ~7u;
+				height_ = std::max(height, 1u);
+				levels_.clear();
+				unsigned int levelWidth = width_;
+				unsigned int levelHeight = height_;
+				for (unsigned int level = 0; level < LEVELCOUNT; ++level) {
+					levels_.push_back({ levelWidth, levelHeight, std::vector<float>(levelWidth * levelHeight, 0.0f), std::vector<float>(levelWidth * levelHeight, 0.0f) });
+					if (levelWidth == 1 && levelHeight == 1) break;
+					levelWidth = (levelWidth + 1) / 2;
+					levelHeight = (levelHeight + 1) / 2;
+				}
+			}
+			// clears the buffer. occluders and tests that follow go through viewProjection.
+			void Begin(const glm::mat4& viewProjection) {
+				viewProjection_ = viewProjection;
+				triangles_.clear();
+				std::fill(levels_[0].min_.begin(), levels_[0].min_.end(), 0.0f);
+				stats_ = {};
+			}
+			// world space triangles, counter clockwise from the front as gl's default has it. back faces are skipped.
+			void AddMesh(const glm::vec3* positions, const unsigned int& vertexCount, const unsigned int* indices, const unsigned int& indexCount) {
+				clipPositions_.resize(vertexCount);
+				for (unsigned int i = 0; i < vertexCount; ++i) clipPositions_[i] = viewProjection_ * glm::vec4(positions[i], 1.0f);
+				const std::size_t trianglesBefore = triangles_.size();
+				for (unsigned int i = 0; i + 2 < indexCount; i += 3) AddTriangle(clipPositions_[indices[i]], clipPositions_[indices[i + 1]], clipPositions_[indices[i + 2]]);
+				++stats_.occluders_;
+				stats_.triangles_ += triangles_.size() - trianglesBefore;
+			}
+			// a solid box, such as a cube, occludes exactly its bounds.
+			void AddBox(const nr::geometry::AABB& box) {
+				// corner i takes max_ on x, y and z for bits 0, 1 and 2. every face winds outwards.
+				static const std::array<unsigned int, 36> BOXINDICES = {
+					0, 4, 6, 0, 6, 2,
+					1, 3, 7, 1, 7, 5,
+					0, 1, 5, 0, 5, 4,
+					2, 6, 7, 2, 7, 3,
+					0, 2, 3, 0, 3, 1,
+					4, 5, 7, 4, 7, 6
+				};
+				std::array<glm::vec3, 8> corners;
+				for (unsigned int corner = 0; corner < 8; ++corner) {
+					corners[corner] = glm::vec3(corner & 1 ? box.max_.x : box.min_.x, corner & 2 ? box.max_.y : box.min_.y, corner & 4 ? box.max_.z : box.min_.z);
+				}
+				AddMesh(corners.data(), corners.size(), BOXINDICES.data(), BOXINDICES.size());
+			}
+			// rasterizes what was added and builds the pyramids. the calling thread takes the first band and waits for the rest.
+			void Rasterize(nr::util::ThreadPool& pool) {
+				const Clock::time_point start = Clock::now();
+				const unsigned int bandCount = (height_ + BANDHEIGHT - 1) / BANDHEIGHT;
+				bands_.clear();
+				for (unsigned int band = 1; band < bandCount; ++band) {
+					bands_.push_back(pool.Submit([this, band]() { RasterizeBand(band * BANDHEIGHT, std::min(height_, (band + 1) * BANDHEIGHT)); }));
+				}
+				RasterizeBand(0, std::min(height_, BANDHEIGHT));
+				for (std::future<void>& band : bands_) band.get();
+				BuildPyramid();
+				stats_.rasterMilliseconds_ = Milliseconds(start, Clock::now());
+			}
+			// false when the box is certainly hidden behind the occluders.
+			bool Visible(const nr::geometry::AABB& box) {
+				++stats_.tested_;
+				if (Test(box)) return true;
+				++stats_.occluded_;
+				return false;
+			}
+			// drops the items Visible rejects, keeping the order of the rest. bounds(item) gives an item's box.
+			template<typename ItemType, typename BoundsFunction>
+			void Cull(std::vector<ItemType>& items, BoundsFunction bounds) {
+				const Clock::time_point start = Clock::now();
+				items.erase(std::remove_if(items.begin(), items.end(), [this, &bounds](const ItemType& item) { return !Visible(bounds(item)); }), items.end());
+				stats_.testMilliseconds_ += Milliseconds(start, Clock::now());
+			}
+			inline unsigned int Width() const noexcept { return width_; }
+			inline unsigned int Height() const noexcept { return height_; }
+			inline const OcclusionStats& Stats() const noexcept { return stats_; }
+		};
+	}
+}
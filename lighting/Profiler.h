@@ -0,0 +1,213 @@
+#pragma once
+#include <glad/glad.h>
+
+// scoped cpu/gpu frame instrumentation. build with NR_PROFILE defined to enable it,
+// otherwise every macro below expands to nothing.
+//
+//   NR_PROFILE_SCOPE("name")      cpu time of the enclosing scope
+//   NR_PROFILE_GPU_SCOPE("name")  cpu time plus gpu time of the commands issued in the scope
+//   NR_PROFILE_FRAME()            closes the frame, call once after swapping
+//   NR_PROFILE_REPORT(stream)     rolling per-scope averages
+//   NR_PROFILE_DUMP(fileName)     chrome trace-event json, open in perfetto or chrome://tracing
+#if defined(NR_PROFILE)
+#include <vector>
+#include <array>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+namespace nr {
+	namespace profiling {
+		inline std::int64_t NowNanoseconds() {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		class Profiler {
+		private:
+			// gpu results are read FRAMESINFLIGHT frames after they were issued, by which point they are normally done.
+			static const unsigned int FRAMESINFLIGHT = 3;
+			// rolling window for the averages, in frames.
+			static const unsigned int HISTORY = 120;
+			// trace recording stops here rather than growing without bound.
+			static const std::size_t MAXTRACEEVENTS = 1 << 20;
+
+			struct GpuEvent {
+				unsigned int scope_;
+				GLuint begin_;
+				GLuint end_;
+			};
+			struct Slot {
+				std::vector<GLuint> queries_;
+				std::vector<GpuEvent> events_;
+				unsigned int used_{ 0 };
+				unsigned int frame_{ 0 };
+			};
+			struct TraceEvent {
+				unsigned int scope_;
+				std::int64_t start_;
+				std::int64_t duration_;
+				bool gpu_;
+			};
+			std::vector<const char*> names_;
+			std::vector<std::array<double, HISTORY>> cpuHistory_;
+			std::vector<std::array<double, HISTORY>> gpuHistory_;
+			std::vector<double> cpuFrame_;
+			std::array<Slot, FRAMESINFLIGHT> slots_;
+			std::vector<TraceEvent> trace_;
+			unsigned int frame_{ 0 };
+			unsigned int stalls_{ 0 };
+			// steady clock minus gl timestamp, to put gpu events on the cpu timeline.
+			std::int64_t gpuOffset_{ 0 };
+			bool gpuSynced_{ false };
+
+			void Record(const TraceEvent& event) {
+				if (trace_.size() < MAXTRACEEVENTS) trace_.push_back(event);
+			}
+			void Resolve(Slot& slot) {
+				std::vector<double> gpuFrame(names_.size(), 0.0);
+				for (const GpuEvent& event : slot.events_) {
+					GLint available = GL_TRUE;
+					glGetQueryObjectiv(event.end_, GL_QUERY_RESULT_AVAILABLE, &available);
+					if (!available) ++stalls_;
+					GLuint64 begin = 0;
+					GLuint64 end = 0;
+					glGetQueryObjectui64v(event.begin_, GL_QUERY_RESULT, &begin);
+					glGetQueryObjectui64v(event.end_, GL_QUERY_RESULT, &end);
+					gpuFrame[event.scope_] += (end - begin) / 1e6;
+					Record({ event.scope_, static_cast<std::int64_t>(begin) + gpuOffset_, static_cast<std::int64_t>(end - begin), true });
+				}
+				for (unsigned int scope = 0; scope < gpuFrame.size(); ++scope) gpuHistory_[scope][slot.frame_ % HISTORY] = gpuFrame[scope];
+				slot.events_.clear();
+				slot.used_ = 0;
+			}
+		public:
+			// scopes are keyed by the name literal's address, so this is a short pointer scan.
+			unsigned int Scope(const char* name) {
+				for (unsigned int i = 0; i < names_.size(); ++i) {
+					if (names_[i] == name) return i;
+				}
+				names_.push_back(name);
+				cpuHistory_.push_back({});
+				gpuHistory_.push_back({});
+				cpuFrame_.push_back(0.0);
+				return names_.size() - 1;
+			}
+			inline void EndCpu(const unsigned int& scope, const std::int64_t& start) {
+				const std::int64_t end = NowNanoseconds();
+				cpuFrame_[scope] += (end - start) / 1e6;
+				Record({ scope, start, end - start, false });
+			}
+			unsigned int BeginGpu(const unsigned int& scope) {
+				if (!gpuSynced_) {
+					GLint64 gpuNow = 0;
+					glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+					gpuOffset_ = NowNanoseconds() - gpuNow;
+					gpuSynced_ = true;
+				}
+				Slot& slot = slots_[frame_ % FRAMESINFLIGHT];
+				if (slot.used_ + 2 > slot.queries_.size()) {
+					slot.queries_.resize(slot.queries_.size() + 2);
+					glGenQueries(2, slot.queries_.data() + slot.queries_.size() - 2);
+				}
+				const GpuEvent event{ scope, slot.queries_[slot.used_], slot.queries_[slot.used_ + 1] };
+				slot.used_ += 2;
+				// timestamps rather than GL_TIME_ELAPSED, since elapsed queries cannot nest.
+				glQueryCounter(event.begin_, GL_TIMESTAMP);
+				slot.events_.push_back(event);
+				return slot.events_.size() - 1;
+			}
+			inline void EndGpu(const unsigned int& event) {
+				glQueryCounter(slots_[frame_ % FRAMESINFLIGHT].events_[event].end_, GL_TIMESTAMP);
+			}
+			void EndFrame() {
+				for (unsigned int scope = 0; scope < cpuFrame_.size(); ++scope) {
+					cpuHistory_[scope][frame_ % HISTORY] = cpuFrame_[scope];
+					cpuFrame_[scope] = 0.0;
+				}
+				++frame_;
+				// the slot this frame will write into was filled FRAMESINFLIGHT frames ago.
+				Slot& slot = slots_[frame_ % FRAMESINFLIGHT];
+				if (!slot.events_.empty()) Resolve(slot);
+				slot.frame_ = frame_;
+			}
+			void Report(std::ostream& out) const {
+				const unsigned int window = frame_ < HISTORY ? frame_ : HISTORY;
+				if (!window) return;
+				for (unsigned int scope = 0; scope < names_.size(); ++scope) {
+					double cpu = 0.0;
+					double gpu = 0.0;
+					for (unsigned int i = 0; i < window; ++i) {
+						cpu += cpuHistory_[scope][i];
+						gpu += gpuHistory_[scope][i];
+					}
+					out << "profile: " << names_[scope] << " cpu " << cpu / window << " ms, gpu " << gpu / window << " ms" << std::endl;
+				}
+				if (stalls_) out << "profile: " << stalls_ << " gpu readbacks stalled" << std::endl;
+			}
+			bool DumpTrace(const std::string& fileName) {
+				for (Slot& slot : slots_) {
+					if (!slot.events_.empty()) Resolve(slot);
+				}
+				std::ofstream file(fileName);
+				if (!file) return false;
+				file << std::fixed << std::setprecision(3);
+				// cpu scopes on thread 1, gpu scopes on thread 2, microsecond timestamps.
+				file << "{\"traceEvents\":[\n";
+				file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"cpu\"}},\n";
+				file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"gpu\"}}";
+				for (const TraceEvent& event : trace_) {
+					file << ",\n{\"name\":\"" << names_[event.scope_] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.gpu_ ? 2 : 1)
+						<< ",\"ts\":" << event.start_ / 1000.0 << ",\"dur\":" << event.duration_ / 1000.0 << "}";
+				}
+				file << "\n]}\n";
+				return bool(file);
+			}
+		};
+		Profiler profiler_;
+
+		class CpuScope {
+		private:
+			unsigned int scope_;
+			std::int64_t start_;
+		public:
+			CpuScope(const char* name)
+				:scope_(profiler_.Scope(name)),
+				start_(NowNanoseconds()) {
+			}
+			~CpuScope() {
+				profiler_.EndCpu(scope_, start_);
+			}
+		};
+		class GpuScope {
+		private:
+			CpuScope cpu_;
+			unsigned int event_;
+		public:
+			GpuScope(const char* name)
+				:cpu_(name),
+				event_(profiler_.BeginGpu(profiler_.Scope(name))) {
+			}
+			~GpuScope() {
+				profiler_.EndGpu(event_);
+			}
+		};
+	}
+}
+#define NR_PROFILE_CONCAT_(a, b) a##b
+#define NR_PROFILE_CONCAT(a, b) NR_PROFILE_CONCAT_(a, b)
+#define NR_PROFILE_SCOPE(name) nr::profiling::CpuScope NR_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define NR_PROFILE_GPU_SCOPE(name) nr::profiling::GpuScope NR_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define NR_PROFILE_FRAME() nr::profiling::profiler_.EndFrame()
+#define NR_PROFILE_REPORT(stream) nr::profiling::profiler_.Report(stream)
+#define NR_PROFILE_DUMP(fileName) nr::profiling::profiler_.DumpTrace(fileName)
+#else
+#define NR_PROFILE_SCOPE(name)
+#define NR_PROFILE_GPU_SCOPE(name)
+#define NR_PROFILE_FRAME()
+#define NR_PROFILE_REPORT(stream)
+#define NR_PROFILE_DUMP(fileName)
+#endif
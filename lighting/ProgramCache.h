@@ -0,0 +1,130 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+namespace nr {
+	namespace driver {
+		// linked program binaries on disk, keyed by a hash of every shader source plus the driver strings.
+		// editing a shader or updating the driver changes the key, so stale binaries are never looked up again.
+		class ProgramCache {
+		private:
+			struct Header {
+				std::uint32_t magic_;
+				std::uint32_t version_;
+				std::uint64_t key_;
+				GLenum format_;
+				GLint length_;
+			};
+			static const std::uint32_t MAGIC = 0x4e525042;
+			// bump when Header changes.
+			static const std::uint32_t VERSION = 1;
+			std::string directory_;
+			std::uint64_t driverKey_{ 0 };
+			bool enabled_{ false };
+			unsigned int hits_{ 0 };
+			unsigned int misses_{ 0 };
+
+			std::string Path(const std::uint64_t& key) const {
+				char name[32];
+				std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+				return (std::filesystem::path(directory_) / name).string();
+			}
+		public:
+			// 64 bit fnv-1a, continuing from hash so several strings can be chained.
+			static std::uint64_t Hash(const void* data, const std::size_t& size, std::uint64_t hash = 14695981039346656037ull) {
+				const unsigned char* bytes = static_cast<const unsigned char*>(data);
+				for (std::size_t i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * 1099511628211ull;
+				return hash;
+			}
+			static inline std::uint64_t Hash(const std::string_view& str, const std::uint64_t& hash) {
+				return Hash(str.data(), str.size(), hash);
+			}
+			// needs a current context. an empty directory leaves the cache off.
+			bool Init(const std::string& directory) {
+				enabled_ = false;
+				directory_ = directory;
+				if (directory_.empty() || !(GLAD_GL_ARB_get_program_binary || GLAD_GL_VERSION_4_1)) return false;
+				GLint formatCount = 0;
+				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+				if (formatCount <= 0) return false;
+				std::error_code error;
+				std::filesystem::create_directories(directory_, error);
+				if (error) {
+					std::cout << "program cache: could not create " << directory_ << std::endl;
+					return false;
+				}
+				const std::uint32_t version = VERSION;
+				driverKey_ = Hash(&version, sizeof(version));
+				for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION }) {
+					const GLubyte* value = glGetString(name);
+					if (value) driverKey_ = Hash(std::string(reinterpret_cast<const char*>(value)), driverKey_);
+				}
+				enabled_ = true;
+				return true;
+			}
+			// start of a program key. fold each shader's type and source in with Hash.
+			inline std::uint64_t DriverKey() const noexcept { return driverKey_; }
+
+			// true if program now holds a linked binary. anything unusable is deleted and reported as a miss.
+			bool Load(const std::uint64_t& key, const GLuint& program) {
+				if (!enabled_) return false;
+				const std::string path = Path(key);
+				std::ifstream file(path, std::ios::binary);
+				Header header{};
+				std::vector<char> binary;
+				if (file && file.read(reinterpret_cast<char*>(&header), sizeof(header)) && header.magic_ == MAGIC && header.version_ == VERSION && header.key_ == key && header.length_ > 0) {
+					binary.resize(header.length_);
+					if (!file.read(binary.data(), binary.size())) binary.clear();
+				}
+				file.close();
+				if (binary.empty()) {
+					++misses_;
+					return false;
+				}
+				glProgramBinary(program, header.format_, binary.data(), binary.size());
+				GLint success = GL_FALSE;
+				glGetProgramiv(program, GL_LINK_STATUS, &success);
+				if (!success) {
+					// the driver may reject its own binaries after an update the version string did not show.
+					std::remove(path.c_str());
+					++misses_;
+					return false;
+				}
+				++hits_;
+				return true;
+			}
+			// program has to be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+			bool Store(const std::uint64_t& key, const GLuint& program) const {
+				if (!enabled_) return false;
+				Header header{ MAGIC, VERSION, key, 0, 0 };
+				glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &header.length_);
+				if (header.length_ <= 0) return false;
+				std::vector<char> binary(header.length_);
+				glGetProgramBinary(program, header.length_, &header.length_, &header.format_, binary.data());
+				// written aside and renamed, so a crash never leaves a truncated binary behind.
+				const std::string path = Path(key);
+				const std::string partialPath = path + ".partial";
+				{
+					std::ofstream file(partialPath, std::ios::binary);
+					if (!file) return false;
+					file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+					file.write(binary.data(), header.length_);
+					if (!file) return false;
+				}
+				std::error_code error;
+				std::filesystem::rename(partialPath, path, error);
+				return !error;
+			}
+			inline bool Enabled() const noexcept { return enabled_; }
+			inline unsigned int Hits() const noexcept { return hits_; }
+			inline unsigned int Misses() const noexcept { return misses_; }
+		};
+	}
+}
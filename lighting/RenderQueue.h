@@ -0,0 +1,247 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "StateCache.h"
+
+namespace nr {
+	namespace driver {
+		// one draw call, with everything it needs bound already.
+		struct DrawCommand {
+			GLenum mode_{ GL_TRIANGLES };
+			GLsizei count_{ 0 };
+			GLenum indexType_{ GL_UNSIGNED_INT };
+			const void* offset_{ nullptr };
+			// instanced when non zero.
+			GLsizei instanceCount_{ 0 };
+			// a glMultiDrawElements when set, count_ and offset_ are then unused.
+			const GLsizei* counts_{ nullptr };
+			const void* const* offsets_{ nullptr };
+			GLsizei drawCount_{ 0 };
+
+			static DrawCommand Elements(const GLsizei& count, const GLenum& indexType, const void* offset = nullptr) {
+				DrawCommand command;
+				command.count_ = count;
+				command.indexType_ = indexType;
+				command.offset_ = offset;
+				return command;
+			}
+			static DrawCommand Instanced(const GLsizei& count, const GLenum& indexType, const GLsizei& instanceCount) {
+				DrawCommand command = Elements(count, indexType);
+				command.instanceCount_ = instanceCount;
+				return command;
+			}
+			// the arrays are read at Submit, so they must outlive it.
+			static DrawCommand Multi(const GLsizei* counts, const void* const* offsets, const GLsizei& drawCount, const GLenum& indexType) {
+				DrawCommand command;
+				command.counts_ = counts;
+				command.offsets_ = offsets;
+				command.drawCount_ = drawCount;
+				command.indexType_ = indexType;
+				return command;
+			}
+			void Issue() const {
+				if (counts_) glMultiDrawElements(mode_, counts_, indexType_, offsets_, drawCount_);
+				else if (instanceCount_) glDrawElementsInstanced(mode_, count_, indexType_, offset_, instanceCount_);
+				else glDrawElements(mode_, count_, indexType_, offset_);
+			}
+			// what the call draws, counting every instance. 0 for anything but GL_TRIANGLES.
+			std::size_t Triangles() const {
+				if (mode_ != GL_TRIANGLES) return 0;
+				if (!counts_) return std::size_t(count_ / 3) * std::max<GLsizei>(instanceCount_, 1);
+				std::size_t triangles = 0;
+				for (GLsizei i = 0; i < drawCount_; ++i) triangles += counts_[i] / 3;
+				return triangles;
+			}
+		};
+		// uniforms shared by everything drawn with it. programs without them skip them.
+		struct Material {
+			glm::vec3 color_{ 1.0f };
+			float ambientScale_{ 0.7f };
+		};
+		// per frame. the submission order counts are what the same items would have cost unsorted.
+		struct RenderQueueStats {
+			unsigned int items_{ 0 };
+			unsigned int programSwitches_{ 0 };
+			unsigned int VAOSwitches_{ 0 };
+			unsigned int materialSwitches_{ 0 };
+			unsigned int submissionProgramSwitches_{ 0 };
+			unsigned int submissionVAOSwitches_{ 0 };
+			unsigned int submissionMaterialSwitches_{ 0 };
+			std::size_t triangles_{ 0 };
+		};
+
+		// draws collected over a frame, then sorted so items sharing state end up next to each other, and
+		// submitted binding only what differs from the item before. the sort key packs, most significant
+		// first, program, vao, material and depth, so the costliest switch happens least often and items
+		// sharing all three go front to back. ProgramType needs Use(), ID(), Handle(name) and the handle setters.
+		template<typename ProgramType>
+		class RenderQueue {
+		private:
+			using handle_type = typename ProgramType::handle_type;
+			static constexpr unsigned int NOMATERIAL = ~0u;
+			static constexpr unsigned int DEPTHBITS = 24;
+			struct DrawItem {
+				ProgramType* program_;
+				GLuint VAO_;
+				unsigned int material_;
+				glm::mat4 model_;
+				DrawCommand command_;
+			};
+			// sorted instead of the items, which are much larger.
+			struct SortEntry {
+				std::uint64_t key_;
+				unsigned int item_;
+			};
+			// a program's handles, resolved the first time it is drawn with.
+			struct ProgramHandles {
+				ProgramType* program_;
+				handle_type model_;
+				handle_type color_;
+				handle_type ambientScale_;
+			};
+			std::vector<DrawItem> items_;
+			std::vector<SortEntry> entries_;
+			std::vector<SortEntry> scratch_;
+			std::vector<Material> materials_;
+			std::vector<ProgramHandles> handles_;
+			glm::vec3 cameraPosition_{ 0.0f };
+			float depthRange_{ 1.0f };
+			RenderQueueStats stats_;
+
+			const ProgramHandles& Handles(ProgramType& program) {
+				for (const ProgramHandles& handles : handles_) {
+					if (handles.program_ == &program) return handles;
+				}
+				handles_.push_back({ &program, program.Handle("modelMatrix"), program.Handle("objectColor"), program.Handle("ambientScale") });
+				return handles_.back();
+			}
+			// the gl names stand in for the objects. only the grouping matters, so a name wider than its field is harmless.
+			std::uint64_t Key(const ProgramType& program, const GLuint& VAO, const unsigned int& material, const glm::vec3& center) const {
+				const float depth = std::min(glm::length(center - cameraPosition_) / depthRange_, 1.0f);
+				const std::uint64_t quantized = static_cast<std::uint64_t>(depth * ((1u << DEPTHBITS) - 1));
+				return (std::uint64_t(program.ID() & 0xFFFF) << 48) | (std::uint64_t(VAO & 0xFFFF) << 32) | (std::uint64_t(material & 0xFF) << DEPTHBITS) | quantized;
+			}
+			// lsd radix sort over key bytes [firstByte, lastByte), a byte per pass. bytes every key shares are
+			// skipped. stable, so keys equal in those bytes keep the order they had.
+			void RadixSort(const unsigned int& firstByte, const unsigned int& lastByte) {
+				const std::size_t count = entries_.size();
+				if (count < 2) return;
+				std::array<std::array<unsigned int, 256>, 8> histograms{};
+				for (const SortEntry& entry : entries_) {
+					for (unsigned int pass = firstByte; pass < lastByte; ++pass) ++histograms[pass][(entry.key_ >> (pass * 8)) & 0xFF];
+				}
+				scratch_.resize(count);
+				for (unsigned int pass = firstByte; pass < lastByte; ++pass) {
+					std::array<unsigned int, 256>& histogram = histograms[pass];
+					const unsigned int shift = pass * 8;
+					if (histogram[(entries_.front().key_ >> shift) & 0xFF] == count) continue;
+					unsigned int offset = 0;
+					for (unsigned int& bucket : histogram) {
+						const unsigned int size = bucket;
+						bucket = offset;
+						offset += size;
+					}
+					for (const SortEntry& entry : entries_) scratch_[histogram[(entry.key_ >> shift) & 0xFF]++] = entry;
+					entries_.swap(scratch_);
+				}
+			}
+			// what the same items would have cost drawn in the order they were added.
+			void CountSubmissionSwitches() {
+				const DrawItem* previous = nullptr;
+				for (const DrawItem& item : items_) {
+					const bool programChanged = !previous || item.program_ != previous->program_;
+					stats_.submissionProgramSwitches_ += programChanged;
+					stats_.submissionVAOSwitches_ += !previous || item.VAO_ != previous->VAO_;
+					stats_.submissionMaterialSwitches_ += programChanged || item.material_ != previous->material_;
+					previous = &item;
+				}
+			}
+		public:
+			// at init. the id goes with every item drawn in it.
+			unsigned int AddMaterial(const Material& material) {
+				materials_.push_back(material);
+				return materials_.size() - 1;
+			}
+			// depthRange is the distance that maps to the back of the depth field, typically the far plane.
+			void Begin(const glm::vec3& cameraPosition, const float& depthRange) {
+				items_.clear();
+				entries_.clear();
+				cameraPosition_ = cameraPosition;
+				depthRange_ = depthRange > 0.0f ? depthRange : 1.0f;
+				stats_ = {};
+			}
+			// center places the item for the front to back order.
+			void Add(ProgramType& program, const GLuint& VAO, const unsigned int& material, const glm::mat4& model, const DrawCommand& command, const glm::vec3& center) {
+				entries_.push_back({ Key(program, VAO, material, center), static_cast<unsigned int>(items_.size()) });
+				items_.push_back({ &program, VAO, material, model, command });
+			}
+			// by the whole key. with few programs, vaos and materials most of the upper bytes are shared and skipped.
+			inline void Sort() { RadixSort(0, 8); }
+			// nearest first, ignoring state. for passes where state barely changes, such as the depth pre-pass.
+			inline void SortFrontToBack() { RadixSort(0, DEPTHBITS / 8); }
+			// issues every item in queue order. state bound before this is not trusted, the first item binds everything.
+			void Submit() {
+				stats_.items_ = items_.size();
+				CountSubmissionSwitches();
+
+				ProgramType* program = nullptr;
+				const ProgramHandles* handles = nullptr;
+				GLuint VAO = 0;
+				bool VAOBound = false;
+				unsigned int material = NOMATERIAL;
+				for (const SortEntry& entry : entries_) {
+					const DrawItem& item = items_[entry.item_];
+					if (item.program_ != program) {
+						program = item.program_;
+						program->Use();
+						handles = &Handles(*program);
+						// uniforms belong to the program, the new one has not seen this material.
+						material = NOMATERIAL;
+						++stats_.programSwitches_;
+					}
+					if (!VAOBound || item.VAO_ != VAO) {
+						VAO = item.VAO_;
+						VAOBound = true;
+						glState_.BindVertexArray(VAO);
+						++stats_.VAOSwitches_;
+					}
+					if (item.material_ != material) {
+						material = item.material_;
+						const Material& values = materials_[material];
+						program->SetUniformVec3(handles->color_, values.color_);
+						program->SetUniformFloat(handles->ambientScale_, values.ambientScale_);
+						++stats_.materialSwitches_;
+					}
+					// the program's uniform cache drops it when it matches the last item's.
+					program->SetUniformMat4(handles->model_, item.model_);
+					item.command_.Issue();
+					stats_.triangles_ += item.command_.Triangles();
+				}
+			}
+			// lays down depth only: every item in queue order with program, and its model matrix, no materials.
+			// color writes are left to the caller. not counted in Stats.
+			void SubmitDepthOnly(ProgramType& program) {
+				program.Use();
+				const ProgramHandles& handles = Handles(program);
+				GLuint VAO = 0;
+				bool VAOBound = false;
+				for (const SortEntry& entry : entries_) {
+					const DrawItem& item = items_[entry.item_];
+					if (!VAOBound || item.VAO_ != VAO) {
+						VAO = item.VAO_;
+						VAOBound = true;
+						glState_.BindVertexArray(VAO);
+					}
+					program.SetUniformMat4(handles.model_, item.model_);
+					item.command_.Issue();
+				}
+			}
+			inline const RenderQueueStats& Stats() const noexcept { return stats_; }
+		};
+	}
+}
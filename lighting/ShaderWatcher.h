@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace nr {
+	namespace driver {
+		// reports watched files written since the last call. on linux this is inotify on the containing
+		// directories, because editors often save by renaming a new file over the old one.
+		// elsewhere it compares modification times on every call.
+		class ShaderWatcher {
+		private:
+			struct WatchedFile {
+				// as passed to Watch.
+				std::string name_;
+				std::filesystem::file_time_type writeTime_;
+			};
+			// keyed by absolute path.
+			std::unordered_map<std::string, WatchedFile> files_;
+#if defined(__linux__)
+			int inotify_{ -1 };
+			std::unordered_map<int, std::filesystem::path> directories_;
+#endif
+			static std::string Absolute(const std::string& fileName) {
+				std::error_code error;
+				return std::filesystem::absolute(fileName, error).lexically_normal().string();
+			}
+		public:
+			ShaderWatcher() = default;
+			ShaderWatcher(const ShaderWatcher&) = delete;
+			ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+			~ShaderWatcher() {
+#if defined(__linux__)
+				if (inotify_ >= 0) close(inotify_);
+#endif
+			}
+			bool Watch(const std::string& fileName) {
+				const std::string path = Absolute(fileName);
+				if (files_.count(path)) return true;
+				std::error_code error;
+				files_[path] = { fileName, std::filesystem::last_write_time(path, error) };
+#if defined(__linux__)
+				if (inotify_ < 0) inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+				const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+				// adding a directory twice hands back the descriptor it already has.
+				const int watch = inotify_ < 0 ? -1 : inotify_add_watch(inotify_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+				if (watch < 0) {
+					std::cout << "watcher: cannot watch " << directory << std::endl;
+					return false;
+				}
+				directories_[watch] = directory;
+#endif
+				return true;
+			}
+			// names as they were passed to Watch, each at most once. never blocks.
+			std::vector<std::string> Changed() {
+				std::vector<std::string> changed;
+				auto add = [&changed](const std::string& name) {
+					if (std::find(changed.begin(), changed.end(), name) == changed.end()) changed.push_back(name);
+				};
+#if defined(__linux__)
+				if (inotify_ < 0) return changed;
+				alignas(inotify_event) char buffer[4096];
+				ssize_t length;
+				while ((length = read(inotify_, buffer, sizeof(buffer))) > 0) {
+					for (const char* event = buffer; event < buffer + length;) {
+						const inotify_event* info = reinterpret_cast<const inotify_event*>(event);
+						event += sizeof(inotify_event) + info->len;
+						auto directory = directories_.find(info->wd);
+						if (!info->len || directory == directories_.end()) continue;
+						auto file = files_.find((directory->second / info->name).string());
+						if (file != files_.end()) add(file->second.name_);
+					}
+				}
+#else
+				for (auto& file : files_) {
+					std::error_code error;
+					const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(file.first, error);
+					if (error || writeTime == file.second.writeTime_) continue;
+					file.second.writeTime_ = writeTime;
+					add(file.second.name_);
+				}
+#endif
+				return changed;
+			}
+		};
+	}
+}
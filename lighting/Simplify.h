@@ -0,0 +1,222 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+#include "Geometry.h"
+#include "Batcher.h"
+
+namespace nr {
+	namespace geometry {
+		// one level of detail: a run of a LODChain's indices.
+		struct LODLevel {
+			unsigned int firstIndex_;
+			unsigned int indexCount_;
+			// how far, in the mesh's units, the level's surface is estimated to stray from the full mesh.
+			float error_;
+		};
+		// levels from full detail down, every one indexing the same vertices, so one vertex buffer serves the chain.
+		struct LODChain {
+			std::vector<unsigned int> indices_;
+			std::vector<LODLevel> levels_;
+		};
+
+		// the sum of squared distances to a set of planes, each weighted by the area it came from.
+		// evaluated over the total weight it is a mean squared distance, the square of a length in mesh units.
+		struct Quadric {
+			// the upper triangle of the symmetric 4x4 matrix, row by row.
+			std::array<double, 10> q_{};
+			double weight_{ 0 };
+
+			void AddPlane(const glm::vec3& normal, const float& distance, const float& weight) {
+				const double a = normal.x, b = normal.y, c = normal.z, d = distance;
+				const std::array<double, 10> plane = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+				for (unsigned int i = 0; i < q_.size(); ++i) q_[i] += plane[i] * weight;
+				weight_ += weight;
+			}
+			Quadric& operator+=(const Quadric& other) {
+				for (unsigned int i = 0; i < q_.size(); ++i) q_[i] += other.q_[i];
+				weight_ += other.weight_;
+				return *this;
+			}
+			double Evaluate(const glm::vec3& point) const {
+				const double x = point.x, y = point.y, z = point.z;
+				const double error = q_[0] * x * x + 2 * q_[1] * x * y + 2 * q_[2] * x * z + 2 * q_[3] * x
+					+ q_[4] * y * y + 2 * q_[5] * y * z + 2 * q_[6] * y
+					+ q_[7] * z * z + 2 * q_[8] * z
+					+ q_[9];
+				return weight_ > 0 ? std::max(error, 0.0) / weight_ : 0.0;
+			}
+		};
+
+		// one pass of half edge collapses over indices, cheapest first, until it holds targetTriangles or runs out of
+		// collapses. a vertex moves or is moved onto at most once a pass, so every cost stays what it was measured as.
+		// returns how many collapses it made, and raises error to the largest it accepted.
+		inline unsigned int CollapseEdges(const std::vector<glm::vec3>& positions, const std::vector<bool>& locked, std::vector<Quadric>& quadrics, std::vector<unsigned int>& indices, const std::size_t& targetTriangles, float& error) {
+			struct Collapse {
+				double cost_;
+				unsigned int from_;
+				unsigned int to_;
+			};
+			const unsigned int vertexCount = positions.size();
+			std::vector<Collapse> collapses;
+			collapses.reserve(indices.size());
+			for (unsigned int i = 0; i < indices.size(); ++i) {
+				const unsigned int a = indices[i];
+				const unsigned int b = indices[i - i % 3 + (i + 1) % 3];
+				// each edge once, from the face that has it in increasing order. boundaries are locked anyway.
+				if (a > b) continue;
+				Quadric merged = quadrics[a];
+				merged += quadrics[b];
+				const double costToB = locked[a] ? -1.0 : merged.Evaluate(positions[b]);
+				const double costToA = locked[b] ? -1.0 : merged.Evaluate(positions[a]);
+				if (costToB < 0.0 && costToA < 0.0) continue;
+				if (costToA < 0.0 || (costToB >= 0.0 && costToB <= costToA)) collapses.push_back({ costToB, a, b });
+				else collapses.push_back({ costToA, b, a });
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost_ < y.cost_; });
+
+			// the triangles around each vertex, for checking a collapse does not fold any of them over.
+			std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+			for (const unsigned int& index : indices) ++firstTriangle[index + 1];
+			for (unsigned int v = 0; v < vertexCount; ++v) firstTriangle[v + 1] += firstTriangle[v];
+			std::vector<unsigned int> triangles(indices.size());
+			std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+			for (unsigned int i = 0; i < indices.size(); ++i) triangles[filled[indices[i]]++] = i / 3;
+
+			std::vector<unsigned int> remap(vertexCount);
+			for (unsigned int v = 0; v < vertexCount; ++v) remap[v] = v;
+			std::vector<bool> touched(vertexCount, false);
+			std::size_t triangleCount = indices.size() / 3;
+			unsigned int collapsed = 0;
+			for (const Collapse& collapse : collapses) {
+				if (triangleCount <= targetTriangles) break;
+				if (touched[collapse.from_] || touched[collapse.to_]) continue;
+				unsigned int removed = 0;
+				bool flips = false;
+				for (unsigned int t = firstTriangle[collapse.from_]; t < firstTriangle[collapse.from_ + 1] && !flips; ++t) {
+					const unsigned int triangle = triangles[t];
+					const std::array<unsigned int, 3> corners = { remap[indices[triangle * 3]], remap[indices[triangle * 3 + 1]], remap[indices[triangle * 3 + 2]] };
+					if (corners[0] == collapse.to_ || corners[1] == collapse.to_ || corners[2] == collapse.to_) {
+						++removed;
+						continue;
+					}
+					std::array<glm::vec3, 3> before;
+					std::array<glm::vec3, 3> after;
+					for (unsigned int corner = 0; corner < 3; ++corner) {
+						before[corner] = positions[corners[corner]];
+						after[corner] = corners[corner] == collapse.from_ ? positions[collapse.to_] : before[corner];
+					}
+					const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+					const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+					flips = glm::dot(normalBefore, normalAfter) <= 0.0f;
+				}
+				if (flips) continue;
+				remap[collapse.from_] = collapse.to_;
+				touched[collapse.from_] = true;
+				touched[collapse.to_] = true;
+				quadrics[collapse.to_] += quadrics[collapse.from_];
+				error = std::max(error, static_cast<float>(std::sqrt(collapse.cost_)));
+				triangleCount -= removed;
+				++collapsed;
+			}
+
+			// drop the triangles that lost a corner.
+			std::size_t kept = 0;
+			for (std::size_t i = 0; i < indices.size(); i += 3) {
+				const unsigned int a = remap[indices[i]];
+				const unsigned int b = remap[indices[i + 1]];
+				const unsigned int c = remap[indices[i + 2]];
+				if (a == b || b == c || c == a) continue;
+				indices[kept++] = a;
+				indices[kept++] = b;
+				indices[kept++] = c;
+			}
+			indices.resize(kept);
+			return collapsed;
+		}
+
+		// quadric error metric simplification (garland and heckbert) by half edge collapse: a vertex only ever moves
+		// onto a neighbour, never to a new position, so every level indexes the original vertices. each level aims for
+		// half the triangles of the one before. vertices sharing a position with another, such as a cube's flat
+		// shaded corners, and vertices on open edges stay put, so simplifying never tears the surface open.
+		inline LODChain BuildLODChain(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const unsigned int& maxLevels = 8) {
+			// a level has to drop at least this share of the triangles before it, to be worth its indices.
+			const float MINREDUCTION = 0.125f;
+			const std::size_t MINTRIANGLES = 8;
+			LODChain chain;
+			chain.indices_ = indices;
+			chain.levels_.push_back({ 0, static_cast<unsigned int>(indices.size()), 0.0f });
+
+			const unsigned int vertexCount = positions.size();
+			std::vector<bool> locked(vertexCount, false);
+			std::vector<unsigned int> byPosition(vertexCount);
+			for (unsigned int v = 0; v < vertexCount; ++v) byPosition[v] = v;
+			auto less = [&positions](const unsigned int& a, const unsigned int& b) {
+				const glm::vec3& p = positions[a];
+				const glm::vec3& q = positions[b];
+				return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+			};
+			std::sort(byPosition.begin(), byPosition.end(), less);
+			for (unsigned int i = 1; i < vertexCount; ++i) {
+				if (positions[byPosition[i]] != positions[byPosition[i - 1]]) continue;
+				locked[byPosition[i]] = true;
+				locked[byPosition[i - 1]] = true;
+			}
+			// an edge used by one triangle is open.
+			std::unordered_map<std::uint64_t, unsigned int> edgeUses;
+			for (unsigned int i = 0; i < indices.size(); ++i) {
+				const unsigned int a = indices[i];
+				const unsigned int b = indices[i - i % 3 + (i + 1) % 3];
+				++edgeUses[(std::uint64_t(std::min(a, b)) << 32) | std::max(a, b)];
+			}
+			for (const auto& edge : edgeUses) {
+				if (edge.second != 1) continue;
+				locked[edge.first >> 32] = true;
+				locked[edge.first & 0xFFFFFFFF] = true;
+			}
+
+			std::vector<Quadric> quadrics(vertexCount);
+			for (unsigned int i = 0; i + 2 < indices.size(); i += 3) {
+				const glm::vec3& a = positions[indices[i]];
+				const glm::vec3& b = positions[indices[i + 1]];
+				const glm::vec3& c = positions[indices[i + 2]];
+				const glm::vec3 normal = glm::cross(b - a, c - a);
+				const float doubleArea = glm::length(normal);
+				if (doubleArea <= 0.0f) continue;
+				const glm::vec3 unitNormal = normal / doubleArea;
+				for (unsigned int corner = 0; corner < 3; ++corner) quadrics[indices[i + corner]].AddPlane(unitNormal, -glm::dot(unitNormal, a), doubleArea * 0.5f);
+			}
+
+			std::vector<unsigned int> current = indices;
+			float error = 0.0f;
+			while (chain.levels_.size() < maxLevels && current.size() / 3 > MINTRIANGLES) {
+				const std::size_t before = current.size() / 3;
+				const std::size_t target = std::max(before / 2, MINTRIANGLES);
+				while (current.size() / 3 > target && CollapseEdges(positions, locked, quadrics, current, target, error)) {}
+				if (current.empty() || current.size() / 3 > before * (1.0f - MINREDUCTION)) break;
+				OptimizeVertexCache(current, 0, current.size());
+				chain.levels_.push_back({ static_cast<unsigned int>(chain.indices_.size()), static_cast<unsigned int>(current.size()), error });
+				chain.indices_.insert(chain.indices_.end(), current.begin(), current.end());
+			}
+			return chain;
+		}
+		template<typename VertexType>
+		LODChain BuildLODChain(const Shape<VertexType>& shape, const unsigned int& maxLevels = 8) {
+			std::vector<glm::vec3> positions(shape.vertices.size());
+			for (unsigned int i = 0; i < positions.size(); ++i) positions[i] = shape.Position(i);
+			return BuildLODChain(positions, shape.indices, maxLevels);
+		}
+		// the coarsest level whose error is within maxError, starting from current. going coarser the level also has to
+		// be within maxError * hysteresis, so a mesh sitting on a threshold does not switch back and forth every frame.
+		inline unsigned int SelectLOD(const LODChain& chain, const unsigned int& current, const float& maxError, const float& hysteresis) {
+			unsigned int level = std::min<unsigned int>(current, chain.levels_.size() - 1);
+			while (level > 0 && chain.levels_[level].error_ > maxError) --level;
+			while (level + 1 < chain.levels_.size() && chain.levels_[level + 1].error_ <= maxError * hysteresis) ++level;
+			return level;
+		}
+	}
+}
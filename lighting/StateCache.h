@@ -0,0 +1,200 @@
+#pragma once
+#include <glad/glad.h>
+#include <array>
+#include <unordered_map>
+#include <iostream>
+
+// shadows the gl state the driver touches every frame, and drops calls that would set it to what it
+// already is. everything binding programs, vaos, buffers or raster state goes through glState_, so
+// the shadow stays true. build with NR_VALIDATE_STATE defined to check the shadow against glGet*
+// before every call, which stalls the pipeline but catches anything changing state behind its back.
+namespace nr {
+	namespace driver {
+		struct StateStats {
+			unsigned int issued_{ 0 };
+			unsigned int redundant_{ 0 };
+			// shadow values the driver disagreed with. only counted when validating.
+			unsigned int desyncs_{ 0 };
+		};
+
+		class StateCache {
+		private:
+			// not known yet, the next call always goes through.
+			static constexpr GLuint UNKNOWN = ~0u;
+			enum BUFFERSLOT { ARRAY, ELEMENTARRAY, UNIFORM, BUFFERSLOTCOUNT };
+			enum CAPABILITY { DEPTHTEST, BLEND, CULLFACE, CAPABILITYCOUNT };
+			GLuint program_{ UNKNOWN };
+			GLuint VAO_{ UNKNOWN };
+			std::array<GLuint, BUFFERSLOTCOUNT> buffers_;
+			// the element array binding is part of the vao, so it comes back with it.
+			std::unordered_map<GLuint, GLuint> elementBuffers_;
+			std::array<GLuint, CAPABILITYCOUNT> capabilities_;
+			GLuint polygonMode_{ UNKNOWN };
+			GLuint depthMask_{ UNKNOWN };
+			// all four channels together, nothing here masks them separately.
+			GLuint colorMask_{ UNKNOWN };
+			GLuint depthFunc_{ UNKNOWN };
+			GLuint blendSource_{ UNKNOWN };
+			GLuint blendDestination_{ UNKNOWN };
+			StateStats stats_;
+
+			static int BufferSlot(const GLenum& target) {
+				switch (target) {
+				case GL_ARRAY_BUFFER: return ARRAY;
+				case GL_ELEMENT_ARRAY_BUFFER: return ELEMENTARRAY;
+				case GL_UNIFORM_BUFFER: return UNIFORM;
+				default: return -1;
+				}
+			}
+			static GLenum BufferQuery(const int& slot) {
+				static const std::array<GLenum, BUFFERSLOTCOUNT> queries = { GL_ARRAY_BUFFER_BINDING, GL_ELEMENT_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING };
+				return queries[slot];
+			}
+			static int Capability(const GLenum& capability) {
+				switch (capability) {
+				case GL_DEPTH_TEST: return DEPTHTEST;
+				case GL_BLEND: return BLEND;
+				case GL_CULL_FACE: return CULLFACE;
+				default: return -1;
+				}
+			}
+			static GLenum CapabilityEnum(const int& capability) {
+				static const std::array<GLenum, CAPABILITYCOUNT> capabilities = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE };
+				return capabilities[capability];
+			}
+			// true when the value is already set. otherwise records it, and the caller issues the call.
+			bool Redundant(GLuint& shadow, const GLuint& value) {
+				if (shadow == value) {
+					++stats_.redundant_;
+					return true;
+				}
+				shadow = value;
+				++stats_.issued_;
+				return false;
+			}
+			// resyncs the shadow to what the driver reports, and says so if they differed.
+			void Check(const char* name, GLuint& shadow, const GLenum& query) {
+				if (shadow == UNKNOWN) return;
+				// some queries, polygon mode among them, write more than one value.
+				GLint actual[4] = {};
+				glGetIntegerv(query, actual);
+				if (static_cast<GLuint>(actual[0]) == shadow) return;
+				std::cout << "state cache: " << name << " shadowed as " << shadow << ", driver has " << actual[0] << std::endl;
+				++stats_.desyncs_;
+				shadow = actual[0];
+			}
+			inline void Verify([[maybe_unused]] const char* name, [[maybe_unused]] GLuint& shadow, [[maybe_unused]] const GLenum& query) {
+#if defined(NR_VALIDATE_STATE)
+				Check(name, shadow, query);
+#endif
+			}
+		public:
+			StateCache() { Invalidate(); }
+			// forgets everything, for after code that changes state without going through the cache.
+			void Invalidate() {
+				program_ = UNKNOWN;
+				VAO_ = UNKNOWN;
+				buffers_.fill(UNKNOWN);
+				elementBuffers_.clear();
+				capabilities_.fill(UNKNOWN);
+				polygonMode_ = depthMask_ = colorMask_ = depthFunc_ = blendSource_ = blendDestination_ = UNKNOWN;
+			}
+			void UseProgram(const GLuint& program) {
+				Verify("program", program_, GL_CURRENT_PROGRAM);
+				if (!Redundant(program_, program)) glUseProgram(program);
+			}
+			void BindVertexArray(const GLuint& VAO) {
+				Verify("vertex array", VAO_, GL_VERTEX_ARRAY_BINDING);
+				if (Redundant(VAO_, VAO)) return;
+				glBindVertexArray(VAO);
+				auto found = elementBuffers_.find(VAO);
+				buffers_[ELEMENTARRAY] = found != elementBuffers_.end() ? found->second : UNKNOWN;
+			}
+			// targets the cache does not track are passed straight through.
+			void BindBuffer(const GLenum& target, const GLuint& buffer) {
+				const int slot = BufferSlot(target);
+				if (slot < 0) {
+					++stats_.issued_;
+					glBindBuffer(target, buffer);
+					return;
+				}
+				Verify("buffer", buffers_[slot], BufferQuery(slot));
+				if (Redundant(buffers_[slot], buffer)) return;
+				glBindBuffer(target, buffer);
+				if (slot == ELEMENTARRAY && VAO_ != UNKNOWN) elementBuffers_[VAO_] = buffer;
+			}
+			// the indexed binding changes with every range, only the generic binding it also sets is shadowed.
+			void BindBufferRange(const GLenum& target, const GLuint& index, const GLuint& buffer, const GLintptr& offset, const GLsizeiptr& size) {
+				++stats_.issued_;
+				glBindBufferRange(target, index, buffer, offset, size);
+				const int slot = BufferSlot(target);
+				if (slot >= 0) buffers_[slot] = buffer;
+			}
+			void Enable(const GLenum& capability) {
+				const int index = Capability(capability);
+				if (index >= 0) {
+					Verify("capability", capabilities_[index], capability);
+					if (Redundant(capabilities_[index], GL_TRUE)) return;
+				}
+				else ++stats_.issued_;
+				glEnable(capability);
+			}
+			void Disable(const GLenum& capability) {
+				const int index = Capability(capability);
+				if (index >= 0) {
+					Verify("capability", capabilities_[index], capability);
+					if (Redundant(capabilities_[index], GL_FALSE)) return;
+				}
+				else ++stats_.issued_;
+				glDisable(capability);
+			}
+			// core profile only has GL_FRONT_AND_BACK.
+			void PolygonMode(const GLenum& mode) {
+				Verify("polygon mode", polygonMode_, GL_POLYGON_MODE);
+				if (!Redundant(polygonMode_, mode)) glPolygonMode(GL_FRONT_AND_BACK, mode);
+			}
+			void DepthMask(const GLboolean& mask) {
+				Verify("depth mask", depthMask_, GL_DEPTH_WRITEMASK);
+				if (!Redundant(depthMask_, mask)) glDepthMask(mask);
+			}
+			void ColorMask(const GLboolean& mask) {
+				Verify("color mask", colorMask_, GL_COLOR_WRITEMASK);
+				if (!Redundant(colorMask_, mask)) glColorMask(mask, mask, mask, mask);
+			}
+			void DepthFunc(const GLenum& func) {
+				Verify("depth func", depthFunc_, GL_DEPTH_FUNC);
+				if (!Redundant(depthFunc_, func)) glDepthFunc(func);
+			}
+			void BlendFunc(const GLenum& source, const GLenum& destination) {
+				Verify("blend source", blendSource_, GL_BLEND_SRC_RGB);
+				Verify("blend destination", blendDestination_, GL_BLEND_DST_RGB);
+				if (blendSource_ == source && blendDestination_ == destination) {
+					++stats_.redundant_;
+					return;
+				}
+				blendSource_ = source;
+				blendDestination_ = destination;
+				++stats_.issued_;
+				glBlendFunc(source, destination);
+			}
+			// checks every shadowed value against the driver. returns whether they all matched.
+			bool Validate() {
+				const unsigned int desyncs = stats_.desyncs_;
+				Check("program", program_, GL_CURRENT_PROGRAM);
+				Check("vertex array", VAO_, GL_VERTEX_ARRAY_BINDING);
+				for (int slot = 0; slot < BUFFERSLOTCOUNT; ++slot) Check("buffer", buffers_[slot], BufferQuery(slot));
+				for (int index = 0; index < CAPABILITYCOUNT; ++index) Check("capability", capabilities_[index], CapabilityEnum(index));
+				Check("polygon mode", polygonMode_, GL_POLYGON_MODE);
+				Check("depth mask", depthMask_, GL_DEPTH_WRITEMASK);
+				Check("color mask", colorMask_, GL_COLOR_WRITEMASK);
+				Check("depth func", depthFunc_, GL_DEPTH_FUNC);
+				Check("blend source", blendSource_, GL_BLEND_SRC_RGB);
+				Check("blend destination", blendDestination_, GL_BLEND_DST_RGB);
+				return stats_.desyncs_ == desyncs;
+			}
+			inline const StateStats& Stats() const noexcept { return stats_; }
+			inline void ResetStats() noexcept { stats_ = {}; }
+		};
+		StateCache glState_;
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <glad/glad.h>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include "StateCache.h"
+
+namespace nr {
+	namespace driver {
+		struct StreamAllocation {
+			void* data_{ nullptr };
+			GLintptr offset_{ 0 };
+			GLsizeiptr size_{ 0 };
+			inline bool Valid() const noexcept { return data_; }
+			template<typename T>
+			inline T* As() const noexcept { return static_cast<T*>(data_); }
+		};
+		struct StreamStats {
+			unsigned int allocations_{ 0 };
+			GLsizeiptr bytes_{ 0 };
+			// frames that found the gpu still reading the region they were about to write.
+			unsigned int waits_{ 0 };
+			// allocations that did not fit in the frame's region.
+			unsigned int overflows_{ 0 };
+		};
+
+		// per-frame data written straight into gpu visible memory. the buffer is split into REGIONCOUNT regions,
+		// one per frame in flight, and each region is fenced once its frame is submitted, so writing never
+		// waits on draws that are still reading. persistently mapped with ARB_buffer_storage, otherwise every
+		// allocation is an unsynchronized glMapBufferRange that the fences make safe.
+		class StreamBuffer {
+		private:
+			static const unsigned int REGIONCOUNT = 3;
+			GLenum target_{ GL_ARRAY_BUFFER };
+			GLuint bufferID_{ 0 };
+			GLsizeiptr regionSize_{ 0 };
+			GLsizeiptr alignment_{ 1 };
+			// null unless persistent.
+			unsigned char* mapping_{ nullptr };
+			std::array<GLsync, REGIONCOUNT> fences_{};
+			unsigned int region_{ 0 };
+			GLsizeiptr head_{ 0 };
+			StreamStats stats_;
+		public:
+			// regionSize is the most a single frame can allocate.
+			bool Init(const GLenum& target, const GLsizeiptr& regionSize, const GLsizeiptr& alignment = 1) {
+				target_ = target;
+				alignment_ = alignment > 0 ? alignment : 1;
+				regionSize_ = (regionSize + alignment_ - 1) / alignment_ * alignment_;
+				glGenBuffers(1, &bufferID_);
+				glState_.BindBuffer(target_, bufferID_);
+				if (GLAD_GL_ARB_buffer_storage || GLAD_GL_VERSION_4_4) {
+					const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+					glBufferStorage(target_, regionSize_ * REGIONCOUNT, NULL, flags);
+					mapping_ = static_cast<unsigned char*>(glMapBufferRange(target_, 0, regionSize_ * REGIONCOUNT, flags));
+					if (!mapping_) std::cout << "stream buffer: persistent map failed" << std::endl;
+					return mapping_;
+				}
+				glBufferData(target_, regionSize_ * REGIONCOUNT, NULL, GL_STREAM_DRAW);
+				return true;
+			}
+			// waits only if the gpu is REGIONCOUNT frames behind.
+			void BeginFrame() {
+				GLsync& fence = fences_[region_];
+				if (fence) {
+					GLenum result = glClientWaitSync(fence, 0, 0);
+					if (result == GL_TIMEOUT_EXPIRED) {
+						++stats_.waits_;
+						while (result == GL_TIMEOUT_EXPIRED) result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+					}
+					glDeleteSync(fence);
+					fence = 0;
+				}
+				head_ = 0;
+			}
+			// invalid when the region is full. the memory is write only, and has to be handed to Commit()
+			// before anything draws from it.
+			StreamAllocation Allocate(const GLsizeiptr& size) {
+				const GLsizeiptr offset = (head_ + alignment_ - 1) / alignment_ * alignment_;
+				if (offset + size > regionSize_) {
+					++stats_.overflows_;
+					return {};
+				}
+				head_ = offset + size;
+				++stats_.allocations_;
+				stats_.bytes_ += size;
+				const GLintptr bufferOffset = region_ * regionSize_ + offset;
+				if (mapping_) return { mapping_ + bufferOffset, bufferOffset, size };
+				glState_.BindBuffer(target_, bufferID_);
+				void* data = glMapBufferRange(target_, bufferOffset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+				return { data, bufferOffset, size };
+			}
+			// coherent persistent mappings need nothing, the fallback unmaps.
+			void Commit(const StreamAllocation& allocation) {
+				if (mapping_ || !allocation.Valid()) return;
+				glState_.BindBuffer(target_, bufferID_);
+				glUnmapBuffer(target_);
+			}
+			StreamAllocation Write(const void* data, const GLsizeiptr& size) {
+				StreamAllocation allocation = Allocate(size);
+				if (!allocation.Valid()) return allocation;
+				std::memcpy(allocation.data_, data, size);
+				Commit(allocation);
+				return allocation;
+			}
+			// after the frame's last draw reading this buffer.
+			void EndFrame() {
+				fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				region_ = (region_ + 1) % REGIONCOUNT;
+			}
+			inline GLuint ID() const noexcept { return bufferID_; }
+			inline bool Persistent() const noexcept { return mapping_; }
+			inline const StreamStats& Stats() const noexcept { return stats_; }
+			inline void ResetStats() noexcept { stats_ = {}; }
+		};
+	}
+}
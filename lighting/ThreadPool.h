@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <algorithm>
+
+namespace nr {
+	namespace util {
+		// fixed set of workers pulling from one fifo queue. for coarse tasks like file reads, not fine grained jobs.
+		class ThreadPool {
+		private:
+			std::vector<std::thread> workers_;
+			std::deque<std::function<void()>> tasks_;
+			std::mutex mutex_;
+			std::condition_variable wake_;
+			bool stopping_{ false };
+
+			void Work() {
+				while (true) {
+					std::function<void()> task;
+					{
+						std::unique_lock<std::mutex> lock(mutex_);
+						wake_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+						if (tasks_.empty()) return;
+						task = std::move(tasks_.front());
+						tasks_.pop_front();
+					}
+					task();
+				}
+			}
+		public:
+			explicit ThreadPool(const unsigned int& threadCount = std::max(1u, std::thread::hardware_concurrency())) {
+				workers_.reserve(threadCount);
+				for (unsigned int i = 0; i < threadCount; ++i) workers_.emplace_back(&ThreadPool::Work, this);
+			}
+			ThreadPool(const ThreadPool&) = delete;
+			ThreadPool& operator=(const ThreadPool&) = delete;
+			// finishes whatever is queued before joining.
+			~ThreadPool() {
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					stopping_ = true;
+				}
+				wake_.notify_all();
+				for (std::thread& worker : workers_) worker.join();
+			}
+			// exceptions thrown by task come back out of the future's get().
+			template<typename Task>
+			auto Submit(Task&& task) -> std::future<decltype(task())> {
+				auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::forward<Task>(task));
+				std::future<decltype(task())> result = packaged->get_future();
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					tasks_.emplace_back([packaged]() { (*packaged)(); });
+				}
+				wake_.notify_one();
+				return result;
+			}
+			inline unsigned int Size() const noexcept { return workers_.size(); }
+		};
+	}
+}
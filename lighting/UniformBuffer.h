@@ -0,0 +1,48 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "StreamBuffer.h"
+
+namespace nr {
+	namespace driver {
+		const GLuint FRAMEBLOCKBINDING = 0;
+
+		// std140 mirror of FrameBlock in the shaders. vec3s are padded out to vec4.
+		struct FrameBlock {
+			glm::mat4 viewMatrix_;
+			glm::mat4 projectionMatrix_;
+			glm::vec4 cameraPosition_;
+			glm::vec4 lightPosition_;
+			glm::vec4 lightColor_;
+		};
+
+		// a block that changes every frame, streamed so an update never waits on draws still using the last one.
+		template<typename BlockType>
+		class UniformBuffer {
+		private:
+			// updates per frame before the region runs out.
+			static const unsigned int UPDATESPERFRAME = 16;
+			StreamBuffer stream_;
+			GLuint binding_{ 0 };
+		public:
+			bool Init(const GLuint& binding) {
+				binding_ = binding;
+				GLint alignment = 256;
+				glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+				const GLsizeiptr blockSize = (sizeof(BlockType) + alignment - 1) / alignment * alignment;
+				return stream_.Init(GL_UNIFORM_BUFFER, blockSize * UPDATESPERFRAME, alignment);
+			}
+			inline void BeginFrame() { stream_.BeginFrame(); }
+			inline void EndFrame() { stream_.EndFrame(); }
+			// draws issued after this see block, earlier ones keep what they had.
+			void Update(const BlockType& block) {
+				const StreamAllocation allocation = stream_.Write(&block, sizeof(BlockType));
+				if (allocation.Valid()) glState_.BindBufferRange(GL_UNIFORM_BUFFER, binding_, stream_.ID(), allocation.offset_, sizeof(BlockType));
+			}
+			inline GLuint ID() const noexcept { return stream_.ID(); }
+			inline GLuint Binding() const noexcept { return binding_; }
+			inline StreamBuffer& Stream() noexcept { return stream_; }
+		};
+	}
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace nr {
+	namespace driver {
+		enum class VERTEXATTRIBUTE : GLuint {
+			POSITION = 0,
+			COLOR = 1,
+			NORMAL,
+			INSTANCE,
+			INSTANCECOLOR
+		};
+	}
+	namespace vertex {
+		struct Attribute {
+			nr::driver::VERTEXATTRIBUTE location_;
+			GLint components_;
+			GLenum type_;
+			GLboolean normalized_;
+			std::size_t offset_;
+		};
+
+		// float -> ieee half, round to nearest. out of range values clamp to inf.
+		inline std::uint16_t ToHalf(const float& value) {
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			const std::uint16_t sign = (bits >> 16) & 0x8000;
+			const int exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+			std::uint32_t mantissa = bits & 0x7fffff;
+			if (exponent <= 0) {
+				if (exponent < -10) return sign;
+				mantissa = (mantissa | 0x800000) >> (1 - exponent);
+				return sign | static_cast<std::uint16_t>((mantissa + 0x1000) >> 13);
+			}
+			if (exponent >= 31) return sign | 0x7c00;
+			// rounding may carry into the exponent, which is still the correct result.
+			return sign | static_cast<std::uint16_t>(((exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+		}
+		inline float FromHalf(const std::uint16_t& half) {
+			const std::uint32_t sign = (half & 0x8000) << 16;
+			std::uint32_t exponent = (half >> 10) & 0x1f;
+			std::uint32_t mantissa = half & 0x3ff;
+			std::uint32_t bits;
+			if (exponent == 0) {
+				if (mantissa == 0) bits = sign;
+				else {
+					// renormalise the subnormal.
+					exponent = 127 - 15 + 1;
+					while (!(mantissa & 0x400)) {
+						mantissa <<= 1;
+						--exponent;
+					}
+					bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+				}
+			}
+			else if (exponent == 31) bits = sign | 0x7f800000 | (mantissa << 13);
+			else bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+		// signed normalized xyz in GL_INT_2_10_10_10_REV order, w = 0.
+		inline std::uint32_t PackNormal(const glm::vec3& normal) {
+			auto component = [](const float& c) {
+				const int value = static_cast<int>(std::round(std::min(std::max(c, -1.0f), 1.0f) * 511.0f));
+				return static_cast<std::uint32_t>(value) & 0x3ff;
+			};
+			return component(normal.x) | (component(normal.y) << 10) | (component(normal.z) << 20);
+		}
+		inline glm::vec3 UnpackNormal(const std::uint32_t& packed) {
+			auto component = [](const std::uint32_t& bits) {
+				// sign extend the 10 bit value.
+				const int value = static_cast<int>(bits << 22) >> 22;
+				return std::max(value / 511.0f, -1.0f);
+			};
+			return glm::vec3(component(packed & 0x3ff), component((packed >> 10) & 0x3ff), component((packed >> 20) & 0x3ff));
+		}
+		// [0,1] rgba as normalized bytes, r in the lowest byte.
+		inline std::uint32_t PackColor(const glm::vec3& color, const float& alpha = 1.0f) {
+			auto channel = [](const float& c) {
+				return static_cast<std::uint32_t>(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+			};
+			return channel(color.x) | (channel(color.y) << 8) | (channel(color.z) << 16) | (channel(alpha) << 24);
+		}
+
+		// vertex types. Layout<VertexType> describes each one to GL and converts to and from plain attributes.
+		struct Position {
+			glm::vec3 position_;
+		};
+		struct Lit {
+			glm::vec3 position_;
+			glm::vec3 normal_;
+			glm::vec3 color_;
+		};
+		// 16 bytes against Lit's 36. half positions keep ~3 significant digits, so keep meshes near their origin.
+		struct PackedLit {
+			std::array<std::uint16_t, 4> position_;
+			std::uint32_t normal_;
+			std::uint32_t color_;
+		};
+		// PackedLit with full float positions, 20 bytes. for geometry baked in at its world position, far from any origin.
+		struct WorldLit {
+			glm::vec3 position_;
+			std::uint32_t normal_;
+			std::uint32_t color_;
+		};
+
+		template<typename VertexType>
+		struct Layout;
+
+		template<>
+		struct Layout<Position> {
+			static constexpr std::array<Attribute, 1> attributes_{ {
+				{ nr::driver::VERTEXATTRIBUTE::POSITION, 3, GL_FLOAT, GL_FALSE, offsetof(Position, position_) }
+			} };
+			static Position Pack(const glm::vec3& position, const glm::vec3&, const glm::vec3&) {
+				return { position };
+			}
+			static inline glm::vec3 Unpack(const Position& vertex) { return vertex.position_; }
+		};
+		template<>
+		struct Layout<Lit> {
+			static constexpr std::array<Attribute, 3> attributes_{ {
+				{ nr::driver::VERTEXATTRIBUTE::POSITION, 3, GL_FLOAT, GL_FALSE, offsetof(Lit, position_) },
+				{ nr::driver::VERTEXATTRIBUTE::NORMAL, 3, GL_FLOAT, GL_FALSE, offsetof(Lit, normal_) },
+				{ nr::driver::VERTEXATTRIBUTE::COLOR, 3, GL_FLOAT, GL_FALSE, offsetof(Lit, color_) }
+			} };
+			static Lit Pack(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& color) {
+				return { position, normal, color };
+			}
+			static inline glm::vec3 Unpack(const Lit& vertex) { return vertex.position_; }
+		};
+		template<>
+		struct Layout<PackedLit> {
+			static constexpr std::array<Attribute, 3> attributes_{ {
+				{ nr::driver::VERTEXATTRIBUTE::POSITION, 4, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedLit, position_) },
+				{ nr::driver::VERTEXATTRIBUTE::NORMAL, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedLit, normal_) },
+				{ nr::driver::VERTEXATTRIBUTE::COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(PackedLit, color_) }
+			} };
+			static PackedLit Pack(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& color) {
+				return { { ToHalf(position.x), ToHalf(position.y), ToHalf(position.z), ToHalf(1.0f) }, PackNormal(normal), PackColor(color) };
+			}
+			static inline glm::vec3 Unpack(const PackedLit& vertex) {
+				return glm::vec3(FromHalf(vertex.position_[0]), FromHalf(vertex.position_[1]), FromHalf(vertex.position_[2]));
+			}
+		};
+		template<>
+		struct Layout<WorldLit> {
+			static constexpr std::array<Attribute, 3> attributes_{ {
+				{ nr::driver::VERTEXATTRIBUTE::POSITION, 3, GL_FLOAT, GL_FALSE, offsetof(WorldLit, position_) },
+				{ nr::driver::VERTEXATTRIBUTE::NORMAL, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(WorldLit, normal_) },
+				{ nr::driver::VERTEXATTRIBUTE::COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(WorldLit, color_) }
+			} };
+			static WorldLit Pack(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& color) {
+				return { position, PackNormal(normal), PackColor(color) };
+			}
+			static inline glm::vec3 Unpack(const WorldLit& vertex) { return vertex.position_; }
+		};
+
+		// points the currently bound VAO at the currently bound GL_ARRAY_BUFFER, laid out as VertexType.
+		template<typename VertexType>
+		void BindLayout() {
+			for (const Attribute& attribute : Layout<VertexType>::attributes_) {
+				const GLuint location = static_cast<GLuint>(attribute.location_);
+				glVertexAttribPointer(location, attribute.components_, attribute.type_, attribute.normalized_, sizeof(VertexType), (void*)attribute.offset_);
+				glEnableVertexAttribArray(location);
+			}
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#version 330 core
+out vec4 fragColor;
+
+layout (std140) uniform FrameBlock {
+mat4 viewMatrix;
+mat4 projectionMatrix;
+vec4 cameraPosition;
+vec4 lightPosition;
+vec4 lightColor;
+};
+
+uniform sampler2D albedoBuffer;
+uniform sampler2D normalBuffer;
+uniform sampler2D depthBuffer;
+
+vec3 DecodeNormal(vec2 encoded)
+{
+vec2 f = encoded*2.0 - 1.0;
+vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+float t = clamp(-n.z, 0.0, 1.0);
+n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+return normalize(n);
+}
+
+// the ambient and LightSource terms of fragmentShader.frag, once per covered pixel.
+void main()
+{
+ivec2 pixel = ivec2(gl_FragCoord.xy);
+// nothing was drawn here, the clear shows through.
+if (texelFetch(depthBuffer, pixel, 0).r == 1.0) discard;
+vec4 albedo = texelFetch(albedoBuffer, pixel, 0);
+vec4 packedNormal = texelFetch(normalBuffer, pixel, 0);
+if (packedNormal.a == 0.0)
+{
+fragColor = vec4(albedo.rgb, 1.0);
+return;
+}
+vec3 normal = DecodeNormal(packedNormal.rg);
+vec3 ambience = lightColor.rgb*albedo.a;
+float angle = max(dot(normal, lightPosition.xyz), 0.0);
+vec3 diffuse = lightColor.rgb*angle;
+fragColor = vec4((ambience + diffuse)*albedo.rgb, 1.0);
+}
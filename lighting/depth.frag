@@ -0,0 +1,6 @@
+#version 330 core
+
+// the depth pre-pass. depth comes from the vertex shader, there is nothing to shade.
+void main()
+{
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 330 core
+in vec3 vertexColor;
+
+out vec4 fragColor;
+
+uniform vec3 objectColor;
+
+// unlit stand-in while the real programs link.
+void main()
+{
+fragColor = vec4(objectColor*vertexColor, 1.0);
+}
\ No newline at end of file
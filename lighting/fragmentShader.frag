@@ -5,22 +5,62 @@ in vec3 worldPosition;
 
 out vec4 fragColor;
 
+layout (std140) uniform FrameBlock {
+mat4 viewMatrix;
+mat4 projectionMatrix;
+vec4 cameraPosition;
+vec4 lightPosition;
+vec4 lightColor;
+};
+
 uniform vec3 objectColor;
-uniform vec3 lightColor;
-uniform vec3 lightPosition;
 
 uniform float ambientScale;
 
+// point lights, found through the cluster this fragment falls in.
+// two texels a light: position and radius, then color.
+uniform samplerBuffer lightData;
+// first index into lightIndices and light count, per cluster.
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer lightIndices;
+uniform vec3 clusterCounts;
+// clusters per pixel on x and y, slices per unit of log depth on z.
+uniform vec3 clusterScale;
+uniform float clusterBias;
+
+vec3 PointLighting(vec3 unitNormal)
+{
+float depth = -(viewMatrix*vec4(worldPosition, 1.0)).z;
+ivec3 cluster = ivec3(vec3(gl_FragCoord.xy*clusterScale.xy, log(depth)*clusterScale.z + clusterBias));
+cluster = clamp(cluster, ivec3(0), ivec3(clusterCounts) - 1);
+int clusterIndex = (cluster.z*int(clusterCounts.y) + cluster.y)*int(clusterCounts.x) + cluster.x;
+uvec2 range = texelFetch(clusterGrid, clusterIndex).rg;
+
+vec3 lighting = vec3(0.0);
+for (uint i = 0u; i < range.y; ++i)
+{
+int light = int(texelFetch(lightIndices, int(range.x + i)).r);
+vec4 positionRadius = texelFetch(lightData, light*2);
+vec3 toLight = positionRadius.xyz - worldPosition;
+float distanceSquared = max(dot(toLight, toLight), 1e-4);
+// smooth window, zero at the radius the light was assigned with.
+float falloff = clamp(1.0 - distanceSquared/(positionRadius.w*positionRadius.w), 0.0, 1.0);
+float angle = max(dot(unitNormal, toLight*inversesqrt(distanceSquared)), 0.0);
+lighting += texelFetch(lightData, light*2 + 1).rgb*angle*falloff*falloff;
+}
+return lighting;
+}
+
 void main()
 {
-vec3 ambience = lightColor*ambientScale;
+vec3 ambience = lightColor.rgb*ambientScale;
 
 vec3 unitNormal = normalize(vertexNormal);
-vec3 lightDirection = normalize(lightPosition - worldPosition);
+vec3 lightDirection = normalize(lightPosition.xyz - worldPosition);
 
-float angle = max(dot(vertexNormal, lightPosition), 0.0);
-vec3 diffuse = lightColor*angle;
-vec3 finalColor = (ambience + diffuse)*objectColor;
+float angle = max(dot(vertexNormal, lightPosition.xyz), 0.0);
+vec3 diffuse = lightColor.rgb*angle;
+vec3 finalColor = (ambience + diffuse + PointLighting(unitNormal))*objectColor*vertexColor;
 // add ambient color
 fragColor = vec4(finalColor, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,32 @@
+#version 330 core
+in vec3 vertexColor;
+in vec3 vertexNormal;
+in vec3 worldPosition;
+
+layout (location = 0) out vec4 albedo;
+layout (location = 1) out vec4 packedNormal;
+
+uniform vec3 objectColor;
+uniform float ambientScale;
+// light sources draw plain white, as lightSourceFragmentShader.frag does.
+uniform int emissive;
+
+// the unit sphere folded onto the octahedron and flattened, two values per normal.
+vec2 EncodeNormal(vec3 n)
+{
+n /= abs(n.x) + abs(n.y) + abs(n.z);
+vec2 folded = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx))*vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+return folded*0.5 + 0.5;
+}
+
+void main()
+{
+if (emissive != 0)
+{
+albedo = vec4(1.0);
+packedNormal = vec4(0.5, 0.5, 0.0, 0.0);
+return;
+}
+albedo = vec4(objectColor*vertexColor, ambientScale);
+packedNormal = vec4(EncodeNormal(normalize(vertexNormal)), 0.0, 1.0);
+}
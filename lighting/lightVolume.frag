@@ -0,0 +1,39 @@
+#version 330 core
+flat in vec4 positionRadius;
+flat in vec3 color;
+
+out vec4 fragColor;
+
+uniform sampler2D albedoBuffer;
+uniform sampler2D normalBuffer;
+uniform sampler2D depthBuffer;
+// clip space back to world space.
+uniform mat4 inverseViewProjection;
+
+vec3 DecodeNormal(vec2 encoded)
+{
+vec2 f = encoded*2.0 - 1.0;
+vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+float t = clamp(-n.z, 0.0, 1.0);
+n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+return normalize(n);
+}
+
+// one light's share of a pixel it may reach, added onto what is there. matches PointLighting in fragmentShader.frag.
+void main()
+{
+ivec2 pixel = ivec2(gl_FragCoord.xy);
+float depth = texelFetch(depthBuffer, pixel, 0).r;
+vec4 packedNormal = texelFetch(normalBuffer, pixel, 0);
+if (depth == 1.0 || packedNormal.a == 0.0) discard;
+
+vec4 clip = vec4(gl_FragCoord.xy/vec2(textureSize(depthBuffer, 0))*2.0 - 1.0, depth*2.0 - 1.0, 1.0);
+vec4 world = inverseViewProjection*clip;
+vec3 toLight = positionRadius.xyz - world.xyz/world.w;
+float distanceSquared = max(dot(toLight, toLight), 1e-4);
+float falloff = clamp(1.0 - distanceSquared/(positionRadius.w*positionRadius.w), 0.0, 1.0);
+if (falloff == 0.0) discard;
+vec3 normal = DecodeNormal(packedNormal.rg);
+float angle = max(dot(normal, toLight*inversesqrt(distanceSquared)), 0.0);
+fragColor = vec4(color*angle*falloff*falloff*texelFetch(albedoBuffer, pixel, 0).rgb, 1.0);
+}
@@ -0,0 +1,27 @@
+#version 330 core
+layout (location = 0) in vec3 vertexPos;
+// per light: position and radius, then color.
+layout (location = 3) in vec4 lightPositionRadius;
+layout (location = 4) in vec4 lightColor;
+
+flat out vec4 positionRadius;
+flat out vec3 color;
+
+layout (std140) uniform FrameBlock {
+mat4 viewMatrix;
+mat4 projectionMatrix;
+vec4 cameraPosition;
+vec4 lightPosition;
+vec4 mainLightColor;
+};
+
+// the volume is an icosahedron, grown until its faces clear the light's sphere.
+uniform float volumeScale;
+
+void main()
+{
+positionRadius = lightPositionRadius;
+color = lightColor.rgb;
+vec3 world = lightPositionRadius.xyz + vertexPos*lightPositionRadius.w*volumeScale;
+gl_Position = projectionMatrix*viewMatrix*vec4(world, 1.0);
+}
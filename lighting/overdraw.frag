@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 fragColor;
+
+// one step of brightness per fragment shaded, added up with blending. a pixel at full white was shaded ten or more times.
+void main()
+{
+fragColor = vec4(vec3(0.1), 1.0);
+}
\ No newline at end of file
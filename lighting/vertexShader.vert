@@ -1,17 +1,32 @@
 #version 330 core
 layout (location = 0) in vec3 vertexPos;
+layout (location = 1) in vec4 color;
 layout (location = 2) in vec3 normal;
+// xyz offset, w scale. constant (0,0,0,1) outside instanced draws.
+layout (location = 3) in vec4 instanceTransform;
+layout (location = 4) in vec4 instanceColor;
 
+out vec3 vertexColor;
 out vec3 vertexNormal;
 out vec3 worldPosition;
+// every program shares this shader, and the depth pre-pass relies on them all producing the same depth.
+invariant gl_Position;
+
+layout (std140) uniform FrameBlock {
+mat4 viewMatrix;
+mat4 projectionMatrix;
+vec4 cameraPosition;
+vec4 lightPosition;
+vec4 lightColor;
+};
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
 
 void main()
 {
-gl_Position = projectionMatrix * viewMatrix *modelMatrix* vec4(vertexPos, 1.0);
+vec4 localPosition = vec4(vertexPos*instanceTransform.w + instanceTransform.xyz, 1.0);
+gl_Position = projectionMatrix * viewMatrix *modelMatrix* localPosition;
+vertexColor = color.rgb*instanceColor.rgb;
 vertexNormal = normal;
-worldPosition = vec3(modelMatrix*vec4(vertexPos,1.0));
+worldPosition = vec3(modelMatrix*localPosition);
 }
\ No newline at end of file
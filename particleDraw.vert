@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 vertexPos;
+// age, lifetime.
+layout (location = 5) in vec2 life;
+
+out vec4 vertexColor;
+
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+uniform float pointSize;
+uniform vec3 particleColor;
+
+void main()
+{
+float alpha = clamp(1.0 - life.x / max(life.y, 1e-6), 0.0, 1.0);
+vertexColor = vec4(particleColor, alpha);
+// dead particles, put them outside the clip volume.
+if (alpha == 0.0) {
+gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+return;
+}
+vec4 viewPosition = viewMatrix * vec4(vertexPos, 1.0);
+gl_Position = projectionMatrix * viewPosition;
+gl_PointSize = max(pointSize / max(-viewPosition.z, 0.1), 1.0);
+}
\ No newline at end of file
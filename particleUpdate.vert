@@ -0,0 +1,72 @@
+#version 330 core
+layout (location = 0) in vec3 vertexPos;
+layout (location = 2) in vec3 velocity;
+layout (location = 3) in float angle;
+// age, lifetime.
+layout (location = 5) in vec2 life;
+
+out vec3 outPosition;
+out vec3 outVelocity;
+out float outAngle;
+out vec2 outLife;
+
+uniform float dt;
+uniform vec3 gravity;
+uniform float damping;
+
+uniform vec3 emitterPosition;
+uniform vec3 emitterVelocity;
+uniform float positionSpread;
+uniform float velocitySpread;
+uniform vec2 lifetimeRange;
+// dead particles in [spawnStart, spawnStart + spawnCount), wrapping at capacity, respawn this frame.
+uniform int spawnStart;
+uniform int spawnCount;
+uniform int capacity;
+uniform uint seed;
+
+uint Hash(uint x)
+{
+x ^= x >> 16;
+x *= 0x7feb352du;
+x ^= x >> 15;
+x *= 0x846ca68bu;
+x ^= x >> 16;
+return x;
+}
+// [0, 1).
+float Random(inout uint state)
+{
+state = Hash(state);
+return float(state >> 8) / 16777216.0;
+}
+
+void main()
+{
+// a fixed spin per slot, so it needs no state of its own.
+float spin = (float(Hash(uint(gl_VertexID)) >> 8) / 16777216.0 - 0.5) * 6.2831853;
+bool dead = life.x >= life.y;
+int slot = (gl_VertexID - spawnStart + capacity) % capacity;
+if (dead && slot < spawnCount) {
+uint state = Hash(uint(gl_VertexID) ^ (seed * 0x9e3779b9u));
+vec3 offset = vec3(Random(state), Random(state), Random(state)) * 2.0 - 1.0;
+vec3 kick = vec3(Random(state), Random(state), Random(state)) * 2.0 - 1.0;
+outPosition = emitterPosition + offset * positionSpread;
+outVelocity = emitterVelocity + kick * velocitySpread;
+outAngle = Random(state) * 6.2831853;
+outLife = vec2(0.0, mix(lifetimeRange.x, lifetimeRange.y, Random(state)));
+return;
+}
+if (dead) {
+outPosition = vertexPos;
+outVelocity = velocity;
+outAngle = angle;
+outLife = life;
+return;
+}
+vec3 newVelocity = (velocity + gravity * dt) * damping;
+outVelocity = newVelocity;
+outPosition = vertexPos + newVelocity * dt;
+outAngle = angle + spin * dt;
+outLife = vec2(life.x + dt, life.y);
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 vertexPos;
+layout (location = 1) in vec4 color;
+
+out vec4 vertexColor;
+
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+uniform float pointSize;
+
+void main()
+{
+vertexColor = color;
+// dead particles are written fully transparent, put them outside the clip volume.
+if (color.a == 0.0) {
+gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+return;
+}
+vec4 viewPosition = viewMatrix * vec4(vertexPos, 1.0);
+gl_Position = projectionMatrix * viewPosition;
+// shrink with distance, but never below a pixel.
+gl_PointSize = max(pointSize / max(-viewPosition.z, 0.1), 1.0);
+}
\ No newline at end of file
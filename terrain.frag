@@ -0,0 +1,27 @@
+#version 330 core
+in vec3 vertexNormal;
+in float vertexHeight;
+in float vertexDistance;
+
+out vec4 fragColor;
+
+uniform vec3 lightDirection;
+uniform vec3 fogColor;
+uniform float fogDistance;
+
+void main()
+{
+vec3 unitNormal = normalize(vertexNormal);
+// grass on the flats, rock on the slopes, snow up high.
+vec3 grass = vec3(0.25, 0.45, 0.2);
+vec3 rock = vec3(0.45, 0.4, 0.35);
+vec3 snow = vec3(0.9, 0.9, 0.95);
+vec3 color = mix(rock, grass, smoothstep(0.7, 0.85, unitNormal.y));
+color = mix(color, snow, smoothstep(-60.0, -30.0, vertexHeight)*smoothstep(0.6, 0.8, unitNormal.y));
+
+float diffuse = max(dot(unitNormal, -lightDirection), 0.0);
+vec3 finalColor = color*(0.3 + 0.7*diffuse);
+// fade into the clear color, so chunks streaming in at the edge of view do not pop.
+float fog = smoothstep(0.6*fogDistance, fogDistance, vertexDistance);
+fragColor = vec4(mix(finalColor, fogColor, fog), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 vertexPos;
+layout (location = 4) in vec3 normal;
+
+out vec3 vertexNormal;
+out float vertexHeight;
+out float vertexDistance;
+
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+uniform vec3 cameraPosition;
+
+void main()
+{
+gl_Position = projectionMatrix * viewMatrix * vec4(vertexPos, 1.0);
+vertexNormal = normal;
+vertexHeight = vertexPos.y;
+vertexDistance = length(vertexPos - cameraPosition);
+}
\ No newline at end of file